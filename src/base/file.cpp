@@ -72,6 +72,16 @@ unsigned long GetFileAge(const std::wstring& path) {
       (ul_now.QuadPart - ul_file.QuadPart) / 10000000);
 }
 
+// Returns the time the file was last modified, in 100-nanosecond intervals
+QWORD GetFileLastWriteTime(const std::wstring& path) {
+  WIN32_FILE_ATTRIBUTE_DATA file_data;
+  if (!::GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &file_data))
+    return 0;
+
+  return MAKEQWORD(file_data.ftLastWriteTime.dwHighDateTime,
+                   file_data.ftLastWriteTime.dwLowDateTime);
+}
+
 QWORD GetFileSize(const std::wstring& path) {
   QWORD file_size = 0;
 
@@ -332,6 +342,23 @@ bool ReadFromFile(const std::wstring& path, std::string& output) {
   return len != -1;
 }
 
+bool AppendToFile(LPCVOID data, DWORD length, const std::wstring& path) {
+  // Make sure the path is available
+  CreateFolder(GetPathOnly(path));
+
+  BOOL result = FALSE;
+  HANDLE file_handle = ::CreateFile(path.c_str(), FILE_APPEND_DATA,
+                                    FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD bytes_written = 0;
+    result = ::WriteFile(file_handle, data, length, &bytes_written, nullptr);
+    ::CloseHandle(file_handle);
+  }
+
+  return result != FALSE;
+}
+
 bool SaveToFile(LPCVOID data, DWORD length, const string_t& path,
                 bool take_backup) {
   // Make sure the path is available
@@ -356,6 +383,35 @@ bool SaveToFile(LPCVOID data, DWORD length, const string_t& path,
   return result != FALSE;
 }
 
+// Writes to a temporary file first, which then replaces the original. The
+// original file is left intact if anything goes wrong along the way.
+bool SaveToFileAtomic(LPCVOID data, DWORD length, const std::wstring& path) {
+  // Make sure the path is available
+  CreateFolder(GetPathOnly(path));
+
+  std::wstring temp_path = path + L".tmp";
+
+  BOOL result = FALSE;
+  HANDLE file_handle = OpenFileForGenericWrite(temp_path);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD bytes_written = 0;
+    result = ::WriteFile(file_handle, data, length, &bytes_written, nullptr);
+    if (result && bytes_written != length)
+      result = FALSE;
+    if (result)
+      result = ::FlushFileBuffers(file_handle);
+    ::CloseHandle(file_handle);
+  }
+
+  if (result)
+    result = ::MoveFileEx(temp_path.c_str(), path.c_str(),
+                          MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+  if (!result)
+    ::DeleteFile(temp_path.c_str());
+
+  return result != FALSE;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 std::wstring ToSizeString(QWORD qwSize) {
@@ -376,4 +432,78 @@ std::wstring ToSizeString(QWORD qwSize) {
   }
 
   return size + unit;
-}
\ No newline at end of file
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile()
+    : file_handle_(INVALID_HANDLE_VALUE),
+      mapping_handle_(nullptr),
+      data_(nullptr),
+      size_(0) {
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::wstring& path) {
+  Close();
+
+  file_handle_ = OpenFileForGenericRead(path);
+  if (file_handle_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD size_high = 0;
+  DWORD size_low = ::GetFileSize(file_handle_, &size_high);
+  QWORD file_size = MAKEQWORD(size_high, size_low);
+
+  // Empty files cannot be mapped, and large ones would not fit into the
+  // address space anyway
+  if (size_low == INVALID_FILE_SIZE || file_size == 0 ||
+      file_size > static_cast<QWORD>(MAXDWORD) / 2) {
+    Close();
+    return false;
+  }
+
+  mapping_handle_ = ::CreateFileMapping(file_handle_, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+  if (!mapping_handle_) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const BYTE*>(
+      ::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    Close();
+    return false;
+  }
+
+  size_ = static_cast<size_t>(file_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    ::UnmapViewOfFile(data_);
+    data_ = nullptr;
+  }
+  if (mapping_handle_) {
+    ::CloseHandle(mapping_handle_);
+    mapping_handle_ = nullptr;
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    ::CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+  size_ = 0;
+}
+
+const BYTE* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
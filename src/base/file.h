@@ -26,6 +26,7 @@
 #include "types.h"
 
 unsigned long GetFileAge(const std::wstring& path);
+QWORD GetFileLastWriteTime(const std::wstring& path);
 QWORD GetFileSize(const std::wstring& path);
 QWORD GetFolderSize(const std::wstring& path, bool recursive);
 
@@ -52,7 +53,9 @@ unsigned int PopulateFiles(std::vector<std::wstring>& file_list, const std::wstr
 int PopulateFolders(std::vector<std::wstring>& folder_list, const std::wstring& path);
 
 bool ReadFromFile(const std::wstring& path, std::string& output);
+bool AppendToFile(LPCVOID data, DWORD length, const std::wstring& path);
 bool SaveToFile(LPCVOID data, DWORD length, const std::wstring& path, bool take_backup = false);
+bool SaveToFileAtomic(LPCVOID data, DWORD length, const std::wstring& path);
 
 std::wstring ToSizeString(QWORD qwSize);
 
@@ -65,6 +68,10 @@ public:
 
   virtual bool OnDirectory(const std::wstring& root, const std::wstring& name) = 0;
   virtual bool OnFile(const std::wstring& root, const std::wstring& name) = 0;
+  // Called with all files of a folder after its subdirectories are searched,
+  // so that they can be processed together. Calls OnFile for each by default.
+  virtual bool OnFiles(const std::wstring& root,
+                       const std::vector<std::wstring>& names);
 
   void set_skip_directories(bool skip_directories);
   void set_skip_files(bool skip_files);
@@ -77,4 +84,25 @@ protected:
   bool skip_subdirectories_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Maps a whole file into memory for reading
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool Open(const std::wstring& path);
+  void Close();
+
+  const BYTE* data() const;
+  size_t size() const;
+
+private:
+  HANDLE file_handle_;
+  HANDLE mapping_handle_;
+  const BYTE* data_;
+  size_t size_;
+};
+
 #endif  // TAIGA_BASE_FILE_H
\ No newline at end of file
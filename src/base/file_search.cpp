@@ -17,6 +17,7 @@
 */
 
 #include "file.h"
+#include "foreach.h"
 #include "log.h"
 #include "string.h"
 
@@ -34,6 +35,7 @@ bool FileSearchHelper::Search(const std::wstring& root) {
     return false;
 
   std::wstring path = AddTrailingSlash(GetExtendedLengthPath(root)) + L"*";
+  std::vector<std::wstring> files;
   bool result = false;
 
   WIN32_FIND_DATA find_data;
@@ -65,12 +67,16 @@ bool FileSearchHelper::Search(const std::wstring& root) {
             L"Path: " + AddTrailingSlash(root) + find_data.cFileName);
         continue;
       }
-      result = OnFile(root, find_data.cFileName);
+      files.push_back(find_data.cFileName);
     }
 
   } while (!result && FindNextFile(handle, &find_data));
 
   FindClose(handle);
+
+  if (!result && !files.empty())
+    result = OnFiles(root, files);
+
   return result;
 }
 
@@ -84,6 +90,15 @@ bool FileSearchHelper::OnFile(const std::wstring& root,
   return false;
 }
 
+bool FileSearchHelper::OnFiles(const std::wstring& root,
+                               const std::vector<std::wstring>& names) {
+  foreach_(it, names)
+    if (OnFile(root, *it))
+      return true;
+
+  return false;
+}
+
 void FileSearchHelper::set_skip_directories(bool skip_directories) {
   skip_directories_ = skip_directories;
 }
@@ -17,6 +17,8 @@
 */
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iomanip>
 #include <locale>
@@ -279,11 +281,176 @@ bool EndsWith(const wstring& str1, const wstring& str2) {
   return str1.compare(str1.length() - str2.length(), str2.length(), str2) == 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Bit-parallel string metrics
+//
+// The following functions represent a column of the dynamic programming table
+// as bits of a single machine word, so that strings of up to 64 characters can
+// be compared without any allocation. The shorter string is used as the
+// pattern. For longer strings, we fall back to the classic algorithms.
+
+const size_t kBitParallelMaxLength = 64;
+
+// Maps each character of the pattern to a bitmask of its positions. The table
+// is small enough to live on the stack; there can be at most 64 distinct
+// characters in the pattern, so it is never more than half full.
+class PatternMatchVector {
+public:
+  PatternMatchVector(const wstring& pattern) {
+    memset(keys_, 0, sizeof(keys_));
+    memset(masks_, 0, sizeof(masks_));
+
+    uint64_t bit = 1;
+    for (size_t i = 0; i < pattern.length(); i++, bit <<= 1) {
+      size_t index = Lookup(pattern[i]);
+      keys_[index] = pattern[i];
+      masks_[index] |= bit;
+    }
+  }
+
+  uint64_t Get(wchar_t c) const {
+    return masks_[Lookup(c)];
+  }
+
+private:
+  static const size_t kSize = 128;
+
+  size_t Lookup(wchar_t c) const {
+    size_t index = (static_cast<size_t>(c) * 2654435761u) % kSize;
+    while (masks_[index] && keys_[index] != c)
+      index = (index + 1) % kSize;
+    return index;
+  }
+
+  wchar_t keys_[kSize];
+  uint64_t masks_[kSize];
+};
+
+static size_t CountBits(uint64_t value) {
+  size_t count = 0;
+  for (; value; count++)
+    value &= value - 1;
+  return count;
+}
+
+// Allison-Dix algorithm, as described by Hyyro
+static size_t BitParallelLcsLength(const wstring& pattern,
+                                   const wstring& text) {
+  PatternMatchVector pm(pattern);
+
+  uint64_t v = ~static_cast<uint64_t>(0);
+
+  for (size_t i = 0; i < text.length(); i++) {
+    uint64_t u = v & pm.Get(text[i]);
+    v = (v + u) | (v - u);
+  }
+
+  uint64_t mask = pattern.length() < 64 ?
+      (static_cast<uint64_t>(1) << pattern.length()) - 1 :
+      ~static_cast<uint64_t>(0);
+
+  return CountBits(~v & mask);
+}
+
+// Each bit of a match vector tells if a common substring ends at that position
+// of the pattern. We extend diagonals only as long as they keep on matching.
+static size_t BitParallelLcSubstrLength(const wstring& pattern,
+                                        const wstring& text) {
+  PatternMatchVector pm(pattern);
+
+  size_t longest_length = 0;
+
+  for (size_t j = 0; j < text.length(); j++) {
+    uint64_t matches = pm.Get(text[j]);
+    for (size_t length = 1; matches; length++) {
+      if (length > longest_length)
+        longest_length = length;
+      if (length > j || length == pattern.length())
+        break;
+      matches &= pm.Get(text[j - length]) << length;
+    }
+  }
+
+  return longest_length;
+}
+
+// Myers' algorithm, as described by Hyyro
+static size_t BitParallelLevenshteinDistance(const wstring& pattern,
+                                             const wstring& text) {
+  PatternMatchVector pm(pattern);
+
+  uint64_t pv = ~static_cast<uint64_t>(0);
+  uint64_t mv = 0;
+  const uint64_t last = static_cast<uint64_t>(1) << (pattern.length() - 1);
+  size_t distance = pattern.length();
+
+  for (size_t i = 0; i < text.length(); i++) {
+    uint64_t eq = pm.Get(text[i]);
+    uint64_t xv = eq | mv;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+
+    if (ph & last) {
+      distance++;
+    } else if (mh & last) {
+      distance--;
+    }
+
+    ph = (ph << 1) | 1;
+    mh = mh << 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+
+  return distance;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 size_t LongestCommonSubsequenceLength(const wstring& str1,
                                       const wstring& str2) {
   if (str1.empty() || str2.empty())
     return 0;
 
+  if (str1.length() <= kBitParallelMaxLength)
+    return BitParallelLcsLength(str1, str2);
+  if (str2.length() <= kBitParallelMaxLength)
+    return BitParallelLcsLength(str2, str1);
+
+  return ClassicLongestCommonSubsequenceLength(str1, str2);
+}
+
+size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
+  if (str1.empty() || str2.empty())
+    return 0;
+
+  if (str1.length() <= kBitParallelMaxLength)
+    return BitParallelLcSubstrLength(str1, str2);
+  if (str2.length() <= kBitParallelMaxLength)
+    return BitParallelLcSubstrLength(str2, str1);
+
+  return ClassicLongestCommonSubstringLength(str1, str2);
+}
+
+size_t LevenshteinDistance(const wstring& str1, const wstring& str2) {
+  if (str1.empty())
+    return str2.size();
+  if (str2.empty())
+    return str1.size();
+
+  if (str1.length() <= kBitParallelMaxLength)
+    return BitParallelLevenshteinDistance(str1, str2);
+  if (str2.length() <= kBitParallelMaxLength)
+    return BitParallelLevenshteinDistance(str2, str1);
+
+  return ClassicLevenshteinDistance(str1, str2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t ClassicLongestCommonSubsequenceLength(const wstring& str1,
+                                             const wstring& str2) {
   const size_t len1 = str1.length();
   const size_t len2 = str2.length();
 
@@ -304,10 +471,8 @@ size_t LongestCommonSubsequenceLength(const wstring& str1,
   return table.back().back();
 }
 
-size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
-  if (str1.empty() || str2.empty())
-    return 0;
-
+size_t ClassicLongestCommonSubstringLength(const wstring& str1,
+                                           const wstring& str2) {
   const size_t len1 = str1.length();
   const size_t len2 = str2.length();
 
@@ -337,7 +502,7 @@ size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
   return longest_length;
 }
 
-size_t LevenshteinDistance(const wstring& str1, const wstring& str2) {
+size_t ClassicLevenshteinDistance(const wstring& str1, const wstring& str2) {
   const size_t len1 = str1.size();
   const size_t len2 = str2.size();
 
@@ -763,49 +928,74 @@ void ReadStringFromResource(LPCWSTR name, LPCWSTR type, wstring& output) {
 // included in the table. Note that characters in the table are listed by their
 // precedence.
 
-const wstring kCommonCharTable = L",_ .-+;&|~";
+const wchar_t kCommonCharTable[] = L",_ .-+;&|~";
+const size_t kCommonCharCount = ARRAYSIZE(kCommonCharTable) - 1;
+
+// Maps ASCII characters to their index in the table, so that we don't have to
+// search the table for every character of a string.
+class CommonCharIndexTable {
+public:
+  CommonCharIndexTable() {
+    std::fill(indexes_, indexes_ + kSize, -1);
+    for (size_t i = 0; i < kCommonCharCount; i++)
+      indexes_[kCommonCharTable[i]] = static_cast<signed char>(i);
+  }
 
-int GetCommonCharIndex(wchar_t c) {
-  for (size_t i = 0; i < kCommonCharTable.size(); i++)
-    if (kCommonCharTable.at(i) == c)
-      return i;
+  int Get(wchar_t c) const {
+    return c < kSize ? indexes_[c] : -1;
+  }
 
-  return -1;
-}
+  static const wchar_t kSize = 128;
 
-wchar_t GetMostCommonCharacter(wstring str) {
-  Trim(str);
+private:
+  signed char indexes_[kSize];
+};
 
-  std::map<wchar_t, int> frequency;
+const CommonCharIndexTable kCommonCharIndexTable;
 
-  for (auto it = str.begin(); it != str.end(); ++it) {
-    if (IsAlphanumeric(*it))
-      continue;
-    if (GetCommonCharIndex(*it) == -1)
-      continue;
+int GetCommonCharIndex(wchar_t c) {
+  return kCommonCharIndexTable.Get(c);
+}
 
-    frequency[*it] += 1;
+wchar_t GetMostCommonCharacter(const wstring& str) {
+  // Leading and trailing spaces are ignored
+  size_t index_begin = str.find_first_not_of(L' ');
+  if (index_begin == wstring::npos)
+    return L'\0';
+  size_t index_end = str.find_last_not_of(L' ') + 1;
+
+  int frequency[kCommonCharCount] = {0};
+
+  for (size_t i = index_begin; i < index_end; i++) {
+    int index = GetCommonCharIndex(str[i]);
+    if (index > -1)
+      frequency[index] += 1;
   }
 
   wchar_t most_common_char = L'\0';
 
-  for (auto it = frequency.begin(); it != frequency.end(); ++it) {
+  // Characters are visited in ascending order, as this affects the result
+  for (wchar_t c = 0; c < CommonCharIndexTable::kSize; c++) {
+    int index = GetCommonCharIndex(c);
+    if (index == -1 || frequency[index] == 0)
+      continue;
+
     if (most_common_char == L'\0') {
-      most_common_char = it->first;
+      most_common_char = c;
       continue;
     }
 
-    int character_distance = GetCommonCharIndex(it->first) -
-                             GetCommonCharIndex(most_common_char);
+    int most_common_index = GetCommonCharIndex(most_common_char);
+    int character_distance = index - most_common_index;
     if (character_distance < 0) {
-      most_common_char = it->first;
+      most_common_char = c;
       continue;
     }
 
-    float frequency_ratio = static_cast<float>(it->second) /
-                            static_cast<float>(frequency[most_common_char]);
+    float frequency_ratio = static_cast<float>(frequency[index]) /
+                            static_cast<float>(frequency[most_common_index]);
     if (frequency_ratio / character_distance > 0.8f) {
-      most_common_char = it->first;
+      most_common_char = c;
     }
   }
 
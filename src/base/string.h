@@ -57,6 +57,11 @@ bool EndsWith(const std::wstring& str, const std::wstring& search);
 size_t LongestCommonSubsequenceLength(const std::wstring& str1, const std::wstring& str2);
 size_t LongestCommonSubstringLength(const std::wstring& str1, const std::wstring& str2);
 size_t LevenshteinDistance(const std::wstring& str1, const std::wstring& str2);
+// Dynamic programming versions of the above, which are used for long strings,
+// and to verify the results of the bit-parallel versions for short ones
+size_t ClassicLongestCommonSubsequenceLength(const std::wstring& str1, const std::wstring& str2);
+size_t ClassicLongestCommonSubstringLength(const std::wstring& str1, const std::wstring& str2);
+size_t ClassicLevenshteinDistance(const std::wstring& str1, const std::wstring& str2);
 
 void Replace(std::wstring& str1, std::wstring str2, std::wstring replace_with, bool replace_all = false, bool case_insensitive = false);
 void ReplaceChar(std::wstring& str, const wchar_t c, const wchar_t replace_with);
@@ -104,6 +109,6 @@ std::wstring PadChar(std::wstring str, const wchar_t ch, const size_t len);
 std::wstring PushString(const std::wstring& str1, const std::wstring& str2);
 void ReadStringFromResource(LPCWSTR name, LPCWSTR type, std::wstring& output);
 
-wchar_t GetMostCommonCharacter(std::wstring str);
+wchar_t GetMostCommonCharacter(const std::wstring& str);
 
 #endif  // TAIGA_BASE_STRING_H
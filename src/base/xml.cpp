@@ -80,4 +80,16 @@ bool XmlWriteDocumentToFile(const pugi::xml_document& document,
   const pugi::char_t* indent = L"\x09";  // horizontal tab
   unsigned int flags = pugi::format_default | pugi::format_write_bom;
   return document.save_file(path.c_str(), indent, flags);
-}
\ No newline at end of file
+}
+
+// Output is identical to the contents of the file that XmlWriteDocumentToFile
+// would write
+void XmlWriteDocumentToString(const pugi::xml_document& document,
+                              std::string& output) {
+  xml_string_writer writer;
+  const pugi::char_t* indent = L"\x09";  // horizontal tab
+  unsigned int flags = pugi::format_default | pugi::format_write_bom;
+  document.save(writer, indent, flags, pugi::encoding_utf8);
+
+  output.swap(writer.result);
+}
@@ -52,5 +52,7 @@ void XmlWriteStrValue(pugi::xml_node& node, const wchar_t* name,
 
 bool XmlWriteDocumentToFile(const pugi::xml_document& document,
                             const std::wstring& path);
+void XmlWriteDocumentToString(const pugi::xml_document& document,
+                              std::string& output);
 
 #endif  // TAIGA_BASE_XML_H
\ No newline at end of file
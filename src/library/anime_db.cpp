@@ -16,6 +16,9 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <sstream>
+
+#include "base/crc.h"
 #include "base/file.h"
 #include "base/foreach.h"
 #include "base/log.h"
@@ -24,6 +27,7 @@
 #include "base/xml.h"
 #include "library/anime.h"
 #include "library/anime_db.h"
+#include "library/anime_db_snapshot.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "sync/manager.h"
@@ -31,6 +35,7 @@
 #include "sync/service.h"
 #include "taiga/http.h"
 #include "taiga/path.h"
+#include "taiga/saver.h"
 #include "taiga/settings.h"
 #include "track/recognition.h"
 #include "ui/dlg/dlg_anime_list.h"
@@ -40,9 +45,27 @@ anime::Database AnimeDatabase;
 
 namespace anime {
 
+Database::Database()
+    : generation_(0),
+      next_id_(1),
+      list_journal_count_(0),
+      service_index_valid_(false) {
+}
+
 bool Database::LoadDatabase() {
+  return LoadDatabase(taiga::GetPath(taiga::kPathDatabaseAnime), true);
+}
+
+bool Database::LoadDatabase(const std::wstring& path, bool use_snapshot) {
+  if (use_snapshot && ReadDatabaseSnapshot(path, items, next_id_)) {
+    // Titles and IDs were changed without going through UpdateItem
+    Meow.InvalidateCleanTitles();
+    service_index_valid_ = false;
+    ++generation_;
+    return true;
+  }
+
   xml_document document;
-  std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnime);
   unsigned int options = pugi::parse_default & ~pugi::parse_eol;
   xml_parse_result parse_result = document.load_file(path.c_str(), options);
 
@@ -53,6 +76,7 @@ bool Database::LoadDatabase() {
   std::wstring meta_version = XmlReadStrValue(meta_node, L"version");
 
   if (!meta_version.empty()) {
+    next_id_ = max(1, XmlReadIntValue(meta_node, L"next_id"));
     xml_node database_node = document.child(L"database");
     ReadDatabaseNode(database_node);
   } else {
@@ -107,9 +131,31 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
     item.SetSynopsis(XmlReadStrValue(node, L"synopsis"));
     item.SetLastModified(_wtoi64(XmlReadStrValue(node, L"modified").c_str()));
   }
+
+  // Titles and IDs were changed without going through UpdateItem
+  Meow.InvalidateCleanTitles();
+  service_index_valid_ = false;
+  ++generation_;
 }
 
 bool Database::SaveDatabase() {
+  return SaveDatabase(taiga::GetPath(taiga::kPathDatabaseAnime));
+}
+
+// Writes the XML file, followed by a snapshot that is only valid for it
+class DatabaseSaveRequest : public taiga::SaveRequest {
+public:
+  bool Write() {
+    if (!SaveRequest::Write())
+      return false;
+    WriteDatabaseSnapshot(path, snapshot);
+    return true;
+  }
+
+  std::vector<BYTE> snapshot;
+};
+
+bool Database::SaveDatabase(const std::wstring& path) {
   if (items.empty())
     return false;
 
@@ -117,12 +163,17 @@ bool Database::SaveDatabase() {
 
   xml_node meta_node = document.append_child(L"meta");
   XmlWriteStrValue(meta_node, L"version", L"1.1");
+  XmlWriteIntValue(meta_node, L"next_id", next_id_);
 
   xml_node database_node = document.append_child(L"database");
   WriteDatabaseNode(database_node);
 
-  std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnime);
-  return XmlWriteDocumentToFile(document, path);
+  DatabaseSaveRequest* request = new DatabaseSaveRequest;
+  request->path = path;
+  XmlWriteDocumentToString(document, request->data);
+  BuildDatabaseSnapshot(items, next_id_, request->snapshot);
+
+  return Saver.Save(request);
 }
 
 void Database::WriteDatabaseNode(xml_node& database_node) {
@@ -188,38 +239,112 @@ Item* Database::FindItem(int id) {
 }
 
 Item* Database::FindItem(const std::wstring& id, enum_t service) {
-  if (!id.empty())
-    foreach_(it, items)
-      if (id == it->second.GetId(service))
-        return &it->second;
+  if (id.empty() || service > sync::kLastService)
+    return nullptr;
 
-  return nullptr;
-}
+  if (!service_index_valid_)
+    RebuildServiceIndex();
 
-Item* Database::FindSequel(int anime_id) {
-  if (taiga::GetCurrentServiceId() != sync::kMyAnimeList)
+  auto& index = service_index_.at(service);
+  auto it = index.find(id);
+  if (it == index.end())
     return nullptr;
 
-  int sequel_id = ID_UNKNOWN;
+  // The item might have been given another ID in the meantime
+  auto item = FindItem(it->second);
+  if (!item || item->GetId(service) != id) {
+    RebuildServiceIndex();
+    it = service_index_.at(service).find(id);
+    if (it == service_index_.at(service).end())
+      return nullptr;
+    item = FindItem(it->second);
+  }
+
+  return item;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Service index
+
+void Database::AddToServiceIndex(const Item& item) {
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+    AddToServiceIndex(item, i);
+}
+
+void Database::AddToServiceIndex(const Item& item, enum_t service) {
+  if (!service_index_valid_)
+    return;
+
+  const std::wstring& id = item.GetId(service);
+  if (id.empty())
+    return;
+
+  // Keep the existing entry unless it's outdated, as FindItem used to return
+  // the first item in the database
+  int& anime_id = service_index_.at(service)[id];
+  if (anime_id != ID_UNKNOWN && anime_id != item.GetId()) {
+    auto indexed_item = FindItem(anime_id);
+    if (indexed_item && indexed_item->GetId(service) == id &&
+        anime_id < item.GetId())
+      return;
+  }
+  anime_id = item.GetId();
+}
+
+void Database::RemoveFromServiceIndex(const Item& item) {
+  if (!service_index_valid_)
+    return;
+
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
+    auto& index = service_index_.at(i);
+    auto it = index.find(item.GetId(i));
+    if (it != index.end() && it->second == item.GetId())
+      index.erase(it);
+  }
+}
+
+void Database::RebuildServiceIndex() {
+  service_index_.clear();
+  service_index_.resize(sync::kLastService + 1);
 
-  switch (anime_id) {
-    #define SEQUEL_ID(p, s) case p: sequel_id = s; break;
-    // Gintama -> Gintama'
-    SEQUEL_ID(918, 9969);
-    // Tegami Bachi -> Tegami Bachi Reverse
-    SEQUEL_ID(6444, 8311);
-    // Fate/Zero -> Fate/Zero 2nd Season
-    SEQUEL_ID(10087, 11741);
-    // Towa no Qwon
-    SEQUEL_ID(10294, 10713);
-    SEQUEL_ID(10713, 10714);
-    SEQUEL_ID(10714, 10715);
-    SEQUEL_ID(10715, 10716);
-    SEQUEL_ID(10716, 10717);
-    #undef SEQUEL_ID
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
+    auto& index = service_index_.at(i);
+    index.rehash(items.size());
+    foreach_(it, items) {
+      const std::wstring& id = it->second.GetId(i);
+      if (!id.empty())
+        index.insert(std::make_pair(id, it->first));  // Keeps the first one
+    }
   }
 
-  return FindItem(sequel_id);
+  service_index_valid_ = true;
+}
+
+void Database::UpdateServiceIndex(const Item& item, enum_t service,
+                                  const std::wstring& previous_id) {
+  if (!service_index_valid_ || service > sync::kLastService)
+    return;
+
+  // The item is still stored under its previous anime ID, and so are its other
+  // entries in the index
+  if (service == sync::kTaiga && !previous_id.empty()) {
+    if (FindItem(ToInt(previous_id)) == &item)
+      service_index_valid_ = false;
+    return;
+  }
+
+  // Items that are not in the database, such as the ones that are parsed from
+  // service responses, are not indexed
+  if (FindItem(item.GetId()) != &item)
+    return;
+
+  auto& index = service_index_.at(service);
+  auto it = index.find(previous_id);
+  if (it != index.end() && it->second == item.GetId())
+    index.erase(it);
+
+  AddToServiceIndex(item, service);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -228,14 +353,19 @@ void Database::ClearInvalidItems() {
   for (auto it = items.begin(); it != items.end(); ) {
     if (!it->second.GetId() || it->first != it->second.GetId()) {
       LOG(LevelDebug, L"ID: " + ToWstr(it->first));
+      RemoveFromServiceIndex(it->second);
       items.erase(it++);
     } else {
       ++it;
     }
   }
+
+  ++generation_;
 }
 
 int Database::UpdateItem(const Item& new_item) {
+  ++generation_;
+
   Item* item = nullptr;
 
   for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
@@ -257,9 +387,7 @@ int Database::UpdateItem(const Item& new_item) {
       // Use MyAnimeList ID, if available
       id = ToInt(new_item.GetId(sync::kMyAnimeList));
     } else {
-      // Generate a new ID
-      while (FindItem(id))
-        ++id;
+      id = GenerateId();
     }
     // Add a new item
     item = &items[id];
@@ -318,6 +446,8 @@ int Database::UpdateItem(const Item& new_item) {
       Meow.UpdateCleanTitles(item->GetId());
   }
 
+  AddToServiceIndex(*item);
+
   // Update user information
   if (new_item.IsInList()) {
     // Make sure our pointer to MyInformation class is valid
@@ -337,6 +467,20 @@ int Database::UpdateItem(const Item& new_item) {
   return item->GetId();
 }
 
+// Returns the first free ID at or above the last one that was given out. As the
+// mark only moves forward, each ID is checked at most once over the lifetime of
+// the database.
+int Database::GenerateId() {
+  while (FindItem(next_id_))
+    ++next_id_;
+
+  return next_id_++;
+}
+
+unsigned int Database::GetGeneration() const {
+  return generation_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -351,13 +495,18 @@ bool Database::LoadList() {
   xml_parse_result parse_result = document.load_file(path.c_str());
 
   if (parse_result.status != pugi::status_ok) {
+    bool result = false;
     if (parse_result.status == pugi::status_file_not_found) {
-      return CheckOldUserDirectory();
+      result = CheckOldUserDirectory();
     } else {
       MessageBox(nullptr, L"Could not read anime list.", path.c_str(),
                  MB_OK | MB_ICONERROR);
-      return false;
     }
+    // The journal may hold changes that never made it to the list file, which
+    // would be lost once the list is saved again
+    if (!result)
+      list_journal_count_ = ReadListJournal();
+    return result;
   }
 
   xml_node meta_node = document.child(L"meta");
@@ -370,27 +519,17 @@ bool Database::LoadList() {
     xml_node node_library = document.child(L"library");
     foreach_xmlnode_(node, node_library, L"anime") {
       Item anime_item;
-      anime_item.SetId(XmlReadStrValue(node, L"id"), sync::kTaiga);
-
-      anime_item.AddtoUserList();
-      anime_item.SetMyLastWatchedEpisode(XmlReadIntValue(node, L"progress"));
-      anime_item.SetMyDateStart(XmlReadStrValue(node, L"date_start"));
-      anime_item.SetMyDateEnd(XmlReadStrValue(node, L"date_end"));
-      anime_item.SetMyScore(XmlReadIntValue(node, L"score"));
-      anime_item.SetMyStatus(XmlReadIntValue(node, L"status"));
-      anime_item.SetMyRewatching(XmlReadIntValue(node, L"rewatching"));
-      anime_item.SetMyRewatchingEp(XmlReadIntValue(node, L"rewatching_ep"));
-      anime_item.SetMyTags(XmlReadStrValue(node, L"tags"));
-      anime_item.SetMyLastUpdated(XmlReadStrValue(node, L"last_updated"));
-
+      ReadListEntry(node, anime_item);
       UpdateItem(anime_item);
     }
-
   } else {
     LOG(LevelWarning, L"Reading list in compatibility mode");
     ReadListInCompatibilityMode(document);
   }
 
+  // Apply the changes that were made after the list was last saved
+  list_journal_count_ = ReadListJournal();
+
   return true;
 }
 
@@ -414,21 +553,147 @@ bool Database::SaveList(bool include_database) {
     Item* item = &it->second;
     if (item->IsInList()) {
       xml_node node = node_library.append_child(L"anime");
-      XmlWriteIntValue(node, L"id", item->GetId());
-      XmlWriteIntValue(node, L"progress", item->GetMyLastWatchedEpisode(false));
-      XmlWriteStrValue(node, L"date_start", std::wstring(item->GetMyDateStart()).c_str());
-      XmlWriteStrValue(node, L"date_end", std::wstring(item->GetMyDateEnd()).c_str());
-      XmlWriteIntValue(node, L"score", item->GetMyScore(false));
-      XmlWriteIntValue(node, L"status", item->GetMyStatus(false));
-      XmlWriteIntValue(node, L"rewatching", item->GetMyRewatching(false));
-      XmlWriteIntValue(node, L"rewatching_ep", item->GetMyRewatchingEp());
-      XmlWriteStrValue(node, L"tags", item->GetMyTags(false).c_str());
-      XmlWriteStrValue(node, L"last_updated", item->GetMyLastUpdated().c_str());
+      WriteListEntry(node, *item);
     }
   }
 
-  std::wstring path = taiga::GetPath(taiga::kPathUserLibrary);
-  return XmlWriteDocumentToFile(document, path);
+  taiga::SaveRequest* request = new taiga::SaveRequest;
+  request->path = taiga::GetPath(taiga::kPathUserLibrary);
+  XmlWriteDocumentToString(document, request->data);
+
+  // Everything in the journal is in the list file now. The journal is deleted
+  // once the list file is written, along with any entries that were appended
+  // before that.
+  request->obsolete_path = taiga::GetPath(taiga::kPathUserLibraryJournal);
+  list_journal_count_ = 0;
+
+  return Saver.Save(request);
+}
+
+// Each entry is written as a single line, and holds the whole state of the
+// item, so that entries can be applied in order without knowing what changed.
+// Removed items are marked as such. Lines begin with the CRC of the entry, so
+// that an entry that was cut short can be told apart from a complete one.
+bool Database::SaveListEntry(int anime_id) {
+  // The list is saved in full every now and then, so that the journal doesn't
+  // grow without bounds
+  const size_t max_journal_count = 100;
+  if (list_journal_count_ >= max_journal_count)
+    return SaveList();
+
+  auto anime_item = FindItem(anime_id);
+  if (!anime_item)
+    return false;
+
+  xml_document document;
+  xml_node node = document.append_child(L"anime");
+  if (anime_item->IsInList()) {
+    WriteListEntry(node, *anime_item);
+  } else {
+    XmlWriteIntValue(node, L"id", anime_id);
+    XmlWriteIntValue(node, L"removed", 1);
+  }
+
+  std::ostringstream stream;
+  node.print(stream, L"", pugi::format_raw, pugi::encoding_utf8);
+  std::string entry = stream.str();
+  std::string crc = WstrToStr(CalculateCrcFromString(StrToWstr(entry)));
+  std::string line = crc + " " + entry + "\n";
+
+  // Must go through the saver as well, to keep the order of writes. This only
+  // fails if the entry could not be queued, or written right away.
+  std::wstring path = taiga::GetPath(taiga::kPathUserLibraryJournal);
+  if (!Saver.AppendToFile(line, path))
+    return SaveList();
+
+  ++list_journal_count_;
+  return true;
+}
+
+bool Database::CompactList() {
+  if (!list_journal_count_)
+    return true;
+
+  return SaveList();
+}
+
+void Database::ReadListEntry(xml_node& node, Item& item) {
+  item.SetId(XmlReadStrValue(node, L"id"), sync::kTaiga);
+
+  item.AddtoUserList();
+  item.SetMyLastWatchedEpisode(XmlReadIntValue(node, L"progress"));
+  item.SetMyDateStart(XmlReadStrValue(node, L"date_start"));
+  item.SetMyDateEnd(XmlReadStrValue(node, L"date_end"));
+  item.SetMyScore(XmlReadIntValue(node, L"score"));
+  item.SetMyStatus(XmlReadIntValue(node, L"status"));
+  item.SetMyRewatching(XmlReadIntValue(node, L"rewatching"));
+  item.SetMyRewatchingEp(XmlReadIntValue(node, L"rewatching_ep"));
+  item.SetMyTags(XmlReadStrValue(node, L"tags"));
+  item.SetMyLastUpdated(XmlReadStrValue(node, L"last_updated"));
+}
+
+void Database::WriteListEntry(xml_node& node, const Item& item) {
+  XmlWriteIntValue(node, L"id", item.GetId());
+  XmlWriteIntValue(node, L"progress", item.GetMyLastWatchedEpisode(false));
+  XmlWriteStrValue(node, L"date_start", std::wstring(item.GetMyDateStart()).c_str());
+  XmlWriteStrValue(node, L"date_end", std::wstring(item.GetMyDateEnd()).c_str());
+  XmlWriteIntValue(node, L"score", item.GetMyScore(false));
+  XmlWriteIntValue(node, L"status", item.GetMyStatus(false));
+  XmlWriteIntValue(node, L"rewatching", item.GetMyRewatching(false));
+  XmlWriteIntValue(node, L"rewatching_ep", item.GetMyRewatchingEp());
+  XmlWriteStrValue(node, L"tags", item.GetMyTags(false).c_str());
+  XmlWriteStrValue(node, L"last_updated", item.GetMyLastUpdated().c_str());
+}
+
+// Returns the number of entries that were applied. Entries that don't match
+// their CRC are skipped, such as one that was being written when the
+// application was closed.
+size_t Database::ReadListJournal() {
+  std::wstring path = taiga::GetPath(taiga::kPathUserLibraryJournal);
+  std::string data;
+  if (!FileExists(path) || !ReadFromFile(path, data))
+    return 0;
+
+  const size_t crc_length = 8;
+  size_t count = 0;
+  size_t line_begin = 0;
+  size_t line_end = data.find('\n');
+
+  // The last line is incomplete if it's not followed by a line break
+  for (; line_end != std::string::npos;
+       line_begin = line_end + 1, line_end = data.find('\n', line_begin)) {
+    std::string line = data.substr(line_begin, line_end - line_begin);
+    if (line.length() <= crc_length + 1 || line.at(crc_length) != ' ') {
+      LOG(LevelWarning, L"Skipped invalid journal entry: " + path);
+      continue;
+    }
+    std::wstring crc = StrToWstr(line.substr(0, crc_length));
+    std::wstring entry = StrToWstr(line.substr(crc_length + 1));
+    if (CalculateCrcFromString(entry) != crc) {
+      LOG(LevelWarning, L"Skipped invalid journal entry: " + path);
+      continue;
+    }
+
+    xml_document document;
+    if (document.load(entry.c_str()).status != pugi::status_ok)
+      continue;
+    xml_node node = document.child(L"anime");
+    if (!node)
+      continue;
+
+    if (XmlReadIntValue(node, L"removed")) {
+      auto anime_item = FindItem(XmlReadIntValue(node, L"id"));
+      if (anime_item)
+        anime_item->RemoveFromUserList();
+    } else {
+      Item anime_item;
+      ReadListEntry(node, anime_item);
+      UpdateItem(anime_item);
+    }
+    count++;
+  }
+
+  return count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -468,6 +733,7 @@ void Database::AddToList(int anime_id, int status) {
     return;
 
   anime_item->AddtoUserList();
+  ++generation_;
 
   HistoryItem history_item;
   history_item.anime_id = anime_id;
@@ -479,7 +745,7 @@ void Database::AddToList(int anime_id, int status) {
   history_item.mode = taiga::kHttpServiceAddLibraryEntry;
   History.queue.Add(history_item);
 
-  SaveList();
+  SaveListEntry(anime_id);
 
   ui::OnLibraryEntryAdd(anime_id);
 }
@@ -489,6 +755,8 @@ void Database::ClearUserData() {
 
   foreach_(it, items)
     it->second.RemoveFromUserList();
+
+  ++generation_;
 }
 
 bool Database::DeleteListItem(int anime_id) {
@@ -500,6 +768,7 @@ bool Database::DeleteListItem(int anime_id) {
     return false;
 
   anime_item->RemoveFromUserList();
+  ++generation_;
 
   ui::ChangeStatusText(L"Item deleted. (" + anime_item->GetTitle() + L")");
   ui::OnLibraryEntryDelete(anime_item->GetId());
@@ -513,6 +782,8 @@ void Database::UpdateItem(const HistoryItem& history_item) {
   if (!anime_item)
     return;
 
+  ++generation_;
+
   // Edit episode
   if (history_item.episode) {
     anime_item->SetMyLastWatchedEpisode(*history_item.episode);
@@ -545,7 +816,7 @@ void Database::UpdateItem(const HistoryItem& history_item) {
     DeleteListItem(anime_item->GetId());
   }
 
-  SaveList();
+  SaveListEntry(anime_item->GetId());
 
   History.queue.Remove();
   History.queue.Check(false);
@@ -596,6 +867,11 @@ void Database::ReadDatabaseInCompatibilityMode(xml_document& document) {
     item.SetSynopsis(XmlReadStrValue(node, L"synopsis"));
     item.SetLastModified(_wtoi64(XmlReadStrValue(node, L"last_modified").c_str()));
   }
+
+  // Titles and IDs were changed without going through UpdateItem
+  Meow.InvalidateCleanTitles();
+  service_index_valid_ = false;
+  ++generation_;
 }
 
 void Database::ReadListInCompatibilityMode(xml_document& document) {
@@ -20,6 +20,9 @@
 #define TAIGA_LIBRARY_ANIME_DB_H
 
 #include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "library/anime_item.h"
 
@@ -33,19 +36,35 @@ namespace anime {
 
 class Database {
 public:
+  Database();
+
+  // Files are written in the background, see taiga::Saver::Save for what the
+  // return values of the Save functions mean
   bool LoadDatabase();
   bool SaveDatabase();
+  // The binary snapshot next to the file is used instead, if it's up to date
+  bool LoadDatabase(const std::wstring& path, bool use_snapshot);
+  bool SaveDatabase(const std::wstring& path);
 
   Item* FindItem(int id);
   Item* FindItem(const std::wstring& id, enum_t service);
-  Item* FindSequel(int anime_id);
 
   void ClearInvalidItems();
   int UpdateItem(const Item& item);
+  // Called by Item::SetId, so that items are found by their new IDs
+  void UpdateServiceIndex(const Item& item, enum_t service,
+                          const std::wstring& previous_id);
+
+  // Changes whenever items are modified through the database
+  unsigned int GetGeneration() const;
 
 public:
   bool LoadList();
   bool SaveList(bool include_database = false);
+  // Appends the entry to the journal, which is merged into the list file by
+  // SaveList. Use instead of SaveList when a single entry has changed.
+  bool SaveListEntry(int anime_id);
+  bool CompactList();
 
   int GetItemCount(int status, bool check_history = true);
 
@@ -62,8 +81,32 @@ private:
   void WriteDatabaseNode(pugi::xml_node& database_node);
 
   bool CheckOldUserDirectory();
+  void ReadListEntry(pugi::xml_node& node, Item& item);
+  void WriteListEntry(pugi::xml_node& node, const Item& item);
+  size_t ReadListJournal();
   void ReadDatabaseInCompatibilityMode(pugi::xml_document& document);
   void ReadListInCompatibilityMode(pugi::xml_document& document);
+
+  int GenerateId();
+
+  void AddToServiceIndex(const Item& item);
+  void AddToServiceIndex(const Item& item, enum_t service);
+  void RemoveFromServiceIndex(const Item& item);
+  void RebuildServiceIndex();
+
+  unsigned int generation_;
+
+  // New IDs are never below this one, so that the IDs of removed items are
+  // not given to new ones. Saved along with the database.
+  int next_id_;
+
+  // Number of entries in the journal since the list was last saved
+  size_t list_journal_count_;
+
+  // Mapped as <service ID, anime ID> for each service. Kept up to date as IDs
+  // are set, and rebuilt on the next lookup after the database is loaded.
+  std::vector<std::unordered_map<std::wstring, int>> service_index_;
+  bool service_index_valid_;
 };
 
 }  // namespace anime
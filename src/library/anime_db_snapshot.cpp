@@ -0,0 +1,343 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <vector>
+
+#include "base/file.h"
+#include "base/foreach.h"
+#include "base/string.h"
+#include "base/time.h"
+#include "library/anime_db_snapshot.h"
+#include "library/anime_item.h"
+#include "sync/manager.h"
+#include "sync/service.h"
+
+namespace anime {
+
+// Must be changed whenever the layout below changes
+static const char snapshot_magic[4] = {'T', 'G', 'D', 'B'};
+static const unsigned int snapshot_version = 2;
+
+// Values are written in the native byte order, and strings as their length
+// followed by their characters, without a terminating null character.
+class SnapshotWriter {
+public:
+  void WriteBytes(const void* value, size_t size) {
+    const BYTE* bytes = static_cast<const BYTE*>(value);
+    data.insert(data.end(), bytes, bytes + size);
+  }
+  void WriteInt(int value) {
+    WriteBytes(&value, sizeof(value));
+  }
+  void WriteInt64(INT64 value) {
+    WriteBytes(&value, sizeof(value));
+  }
+  void WriteString(const std::wstring& str) {
+    WriteInt(static_cast<int>(str.length()));
+    WriteBytes(str.data(), str.length() * sizeof(wchar_t));
+  }
+  void WriteStrings(const std::vector<std::wstring>& strings) {
+    WriteInt(static_cast<int>(strings.size()));
+    foreach_(it, strings)
+      WriteString(*it);
+  }
+
+  std::vector<BYTE> data;
+};
+
+// Reads from a mapped file. Once a read goes out of bounds, every read fails,
+// so that the result only needs to be checked at the end.
+class SnapshotReader {
+public:
+  SnapshotReader(const BYTE* data, size_t size)
+      : pos_(data), end_(data + size), valid_(true) {}
+
+  bool ReadBytes(void* value, size_t size) {
+    if (!Check(size))
+      return false;
+    memcpy(value, pos_, size);
+    pos_ += size;
+    return true;
+  }
+  bool ReadInt(int& value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+  bool ReadInt64(INT64& value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+  bool ReadString(std::wstring* str) {
+    int length = 0;
+    if (!ReadInt(length) || length < 0 || !Check(length * sizeof(wchar_t)))
+      return false;
+    if (str)
+      str->assign(reinterpret_cast<const wchar_t*>(pos_), length);
+    pos_ += length * sizeof(wchar_t);
+    return true;
+  }
+  bool ReadStrings(std::vector<std::wstring>* strings) {
+    int count = 0;
+    if (!ReadInt(count) || count < 0)
+      return false;
+    if (strings)
+      strings->resize(count);
+    for (int i = 0; i < count; i++)
+      if (!ReadString(strings ? &strings->at(i) : nullptr))
+        return false;
+    return true;
+  }
+
+  bool valid() const { return valid_; }
+
+private:
+  bool Check(size_t size) {
+    if (!valid_ || static_cast<size_t>(end_ - pos_) < size)
+      valid_ = false;
+    return valid_;
+  }
+
+  const BYTE* pos_;
+  const BYTE* end_;
+  bool valid_;
+};
+
+class SnapshotHeader {
+public:
+  char magic[4];
+  unsigned int version;
+  unsigned int service_count;
+  unsigned int item_count;
+  QWORD source_size;
+  QWORD source_time;
+  int next_id;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Values are stored the way Database::WriteDatabaseNode stores them in the XML
+// file, so that an item looks the same whichever file it was loaded from.
+static int NormalizeInt(int value) {
+  return value > 0 ? value : 0;  // Non-positive values are not written to XML
+}
+
+static std::wstring NormalizeDate(const Date& date) {
+  return date ? std::wstring(date) : std::wstring();
+}
+
+static enum_t NormalizeSource(enum_t source) {
+  // Unknown services fall back to Taiga when read from XML
+  auto service = ServiceManager.service(static_cast<sync::ServiceId>(source));
+  return service ? service->id() : sync::kTaiga;
+}
+
+static void WriteItem(SnapshotWriter& writer, const Item& item) {
+  writer.WriteInt(ToInt(item.GetId(sync::kTaiga)));
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+    writer.WriteString(item.GetId(i));
+
+  writer.WriteInt(NormalizeSource(item.GetSource()));
+  writer.WriteString(item.GetSlug());
+  writer.WriteString(item.GetTitle());
+  writer.WriteString(item.GetEnglishTitle());
+  writer.WriteStrings(item.GetSynonyms());
+  writer.WriteInt(NormalizeInt(item.GetType()));
+  writer.WriteInt(NormalizeInt(item.GetAiringStatus()));
+  writer.WriteInt(NormalizeInt(item.GetEpisodeCount()));
+  writer.WriteInt(NormalizeInt(item.GetEpisodeLength()));
+  writer.WriteString(NormalizeDate(item.GetDateStart()));
+  writer.WriteString(NormalizeDate(item.GetDateEnd()));
+  writer.WriteString(item.GetImageUrl());
+  writer.WriteString(Join(item.GetGenres(), L", "));
+  writer.WriteString(Join(item.GetProducers(), L", "));
+  writer.WriteString(item.GetScore());
+  writer.WriteString(item.GetPopularity());
+  writer.WriteString(item.GetSynopsis());
+  writer.WriteInt64(item.GetLastModified());
+}
+
+// Only validates the item if items is null
+static bool ReadItem(SnapshotReader& reader, std::map<int, Item>* items) {
+  int anime_id = 0;
+  std::vector<std::wstring> ids(sync::kLastService + 1);
+  reader.ReadInt(anime_id);
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+    reader.ReadString(items ? &ids.at(i) : nullptr);
+
+  int source = 0, type = 0, status = 0, episode_count = 0, episode_length = 0;
+  std::wstring slug, title, english, date_start, date_end, image, genres,
+               producers, score, popularity, synopsis;
+  std::vector<std::wstring> synonyms;
+  INT64 modified = 0;
+
+  reader.ReadInt(source);
+  reader.ReadString(items ? &slug : nullptr);
+  reader.ReadString(items ? &title : nullptr);
+  reader.ReadString(items ? &english : nullptr);
+  reader.ReadStrings(items ? &synonyms : nullptr);
+  reader.ReadInt(type);
+  reader.ReadInt(status);
+  reader.ReadInt(episode_count);
+  reader.ReadInt(episode_length);
+  reader.ReadString(items ? &date_start : nullptr);
+  reader.ReadString(items ? &date_end : nullptr);
+  reader.ReadString(items ? &image : nullptr);
+  reader.ReadString(items ? &genres : nullptr);
+  reader.ReadString(items ? &producers : nullptr);
+  reader.ReadString(items ? &score : nullptr);
+  reader.ReadString(items ? &popularity : nullptr);
+  reader.ReadString(items ? &synopsis : nullptr);
+  reader.ReadInt64(modified);
+
+  if (!reader.valid() || !items)
+    return reader.valid();
+
+  Item& item = (*items)[anime_id];  // Creates the item if it doesn't exist
+
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+    if (!ids.at(i).empty())
+      item.SetId(ids.at(i), i);
+
+  item.SetSource(static_cast<enum_t>(source));
+  item.SetSlug(slug);
+
+  item.SetTitle(title);
+  item.SetEnglishTitle(english);
+  item.SetSynonyms(synonyms);
+  item.SetType(type);
+  item.SetAiringStatus(status);
+  item.SetEpisodeCount(episode_count);
+  item.SetEpisodeLength(episode_length);
+  item.SetDateStart(Date(date_start));
+  item.SetDateEnd(Date(date_end));
+  item.SetImageUrl(image);
+  item.SetGenres(genres);
+  item.SetProducers(producers);
+  item.SetScore(score);
+  item.SetPopularity(popularity);
+  item.SetSynopsis(synopsis);
+  item.SetLastModified(static_cast<time_t>(modified));
+
+  return true;
+}
+
+static bool ReadHeader(SnapshotReader& reader, SnapshotHeader& header) {
+  reader.ReadBytes(header.magic, sizeof(header.magic));
+  reader.ReadBytes(&header.version, sizeof(header.version));
+  reader.ReadBytes(&header.service_count, sizeof(header.service_count));
+  reader.ReadBytes(&header.item_count, sizeof(header.item_count));
+  reader.ReadBytes(&header.source_size, sizeof(header.source_size));
+  reader.ReadBytes(&header.source_time, sizeof(header.source_time));
+  reader.ReadInt(header.next_id);
+
+  return reader.valid();
+}
+
+static void WriteHeader(SnapshotWriter& writer, const SnapshotHeader& header) {
+  writer.WriteBytes(header.magic, sizeof(header.magic));
+  writer.WriteBytes(&header.version, sizeof(header.version));
+  writer.WriteBytes(&header.service_count, sizeof(header.service_count));
+  writer.WriteBytes(&header.item_count, sizeof(header.item_count));
+  writer.WriteBytes(&header.source_size, sizeof(header.source_size));
+  writer.WriteBytes(&header.source_time, sizeof(header.source_time));
+  writer.WriteInt(header.next_id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::wstring GetDatabaseSnapshotPath(const std::wstring& source_path) {
+  return GetFileWithoutExtension(source_path) + L".bin";
+}
+
+bool ReadDatabaseSnapshot(const std::wstring& source_path,
+                          std::map<int, Item>& items, int& next_id) {
+  MappedFile file;
+  if (!file.Open(GetDatabaseSnapshotPath(source_path)))
+    return false;
+
+  SnapshotReader reader(file.data(), file.size());
+  SnapshotHeader header;
+  if (!ReadHeader(reader, header))
+    return false;
+
+  if (memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0 ||
+      header.version != snapshot_version ||
+      header.service_count != sync::kLastService + 1)
+    return false;
+
+  // Leave if the XML file has changed since the snapshot was written
+  if (header.source_size != GetFileSize(source_path) ||
+      header.source_time != GetFileLastWriteTime(source_path))
+    return false;
+
+  // Make sure that the whole file is readable before touching any items
+  SnapshotReader validator = reader;
+  for (unsigned int i = 0; i < header.item_count; i++)
+    if (!ReadItem(validator, nullptr))
+      return false;
+
+  for (unsigned int i = 0; i < header.item_count; i++)
+    ReadItem(reader, &items);
+
+  next_id = header.next_id;
+  return true;
+}
+
+void BuildDatabaseSnapshot(const std::map<int, Item>& items, int next_id,
+                           std::vector<BYTE>& data) {
+  SnapshotHeader header;
+  memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+  header.version = snapshot_version;
+  header.service_count = sync::kLastService + 1;
+  header.item_count = static_cast<unsigned int>(items.size());
+  header.source_size = 0;
+  header.source_time = 0;
+  header.next_id = next_id;
+
+  SnapshotWriter writer;
+  writer.data.reserve(items.size() * 1024);
+  WriteHeader(writer, header);
+  foreach_(it, items)
+    WriteItem(writer, it->second);
+
+  data.swap(writer.data);
+}
+
+bool WriteDatabaseSnapshot(const std::wstring& source_path,
+                           std::vector<BYTE>& data) {
+  SnapshotReader reader(data.data(), data.size());
+  SnapshotHeader header;
+  if (!ReadHeader(reader, header))
+    return false;
+
+  header.source_size = GetFileSize(source_path);
+  header.source_time = GetFileLastWriteTime(source_path);
+
+  // Without a source, the snapshot could never be valid
+  if (!header.source_size)
+    return false;
+
+  // The header has a fixed size, so it can be overwritten in place
+  SnapshotWriter writer;
+  WriteHeader(writer, header);
+  memcpy(data.data(), writer.data.data(), writer.data.size());
+
+  std::wstring path = GetDatabaseSnapshotPath(source_path);
+  return SaveToFileAtomic(data.data(), static_cast<DWORD>(data.size()), path);
+}
+
+}  // namespace anime
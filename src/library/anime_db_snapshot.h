@@ -0,0 +1,53 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_LIBRARY_ANIME_DB_SNAPSHOT_H
+#define TAIGA_LIBRARY_ANIME_DB_SNAPSHOT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/types.h"
+
+namespace anime {
+
+class Item;
+
+// A snapshot is a binary copy of the anime database, written next to the XML
+// file so that it can be loaded without parsing. It is only valid for the XML
+// file that it was written along with, which is checked through the size and
+// modification time of that file.
+
+std::wstring GetDatabaseSnapshotPath(const std::wstring& source_path);
+
+// Items are merged into the existing ones, as in Database::ReadDatabaseNode.
+// Nothing is modified if the snapshot is missing, outdated or corrupt.
+bool ReadDatabaseSnapshot(const std::wstring& source_path,
+                          std::map<int, Item>& items, int& next_id);
+
+// Snapshots are built on the main thread, but may be written later on, once
+// the XML file is written. The header is completed at that point.
+void BuildDatabaseSnapshot(const std::map<int, Item>& items, int next_id,
+                           std::vector<BYTE>& data);
+bool WriteDatabaseSnapshot(const std::wstring& source_path,
+                           std::vector<BYTE>& data);
+
+}  // namespace anime
+
+#endif  // TAIGA_LIBRARY_ANIME_DB_SNAPSHOT_H
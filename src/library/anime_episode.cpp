@@ -26,11 +26,12 @@ anime::Episode CurrentEpisode;
 namespace anime {
 
 Episode::Episode()
-    : anime_id(ID_UNKNOWN), processed(false) {
+    : anime_id(ID_UNKNOWN), title_anime_id(ID_UNKNOWN), processed(false) {
 }
 
 void Episode::Clear() {
   anime_id = ID_UNKNOWN;
+  title_anime_id = ID_UNKNOWN;
   audio_type.clear();
   checksum.clear();
   extras.clear();
@@ -32,6 +32,9 @@ class Episode {
   void Set(int anime_id);
 
   int anime_id;
+  // The item that the title was matched to, which is a prequel of anime_id if
+  // the episode number belongs to a sequel
+  int title_anime_id;
   std::wstring file;
   std::wstring folder;
   std::wstring format;
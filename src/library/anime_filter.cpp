@@ -46,8 +46,10 @@ bool Filters::CheckItem(Item& item) {
   std::vector<std::wstring> words;
   Split(text, L" ", words);
   RemoveEmptyStrings(words);
+  if (words.empty())
+    return true;
   std::wstring genres = Join(item.GetGenres(), L", ");
-  auto synonyms = item.GetSynonyms();
+  const auto& synonyms = item.GetSynonyms();
   for (auto it = words.begin(); it != words.end(); ++it) {
     if (InStr(item.GetTitle(), *it, 0, true) == -1 &&
         InStr(genres, *it, 0, true) == -1 &&
@@ -34,6 +34,8 @@ namespace anime {
 
 Item::Item() {
   metadata_.uid.resize(sync::kLastService + 1);
+  metadata_.extent[0] = kUnknownEpisodeCount;
+  metadata_.extent[1] = kUnknownEpisodeLength;
 }
 
 Item::~Item() {
@@ -54,10 +56,7 @@ const std::wstring& Item::GetId(enum_t service) const {
 }
 
 const std::wstring& Item::GetSlug() const {
-  if (metadata_.resource.size() > 1)
-    return metadata_.resource.at(1);
-
-  return EmptyString();
+  return metadata_.resource[1];
 }
 
 enum_t Item::GetSource() const {
@@ -69,17 +68,11 @@ int Item::GetType() const {
 }
 
 int Item::GetEpisodeCount() const {
-  if (metadata_.extent.size() > 0)
-    return metadata_.extent.at(0);
-
-  return kUnknownEpisodeCount;
+  return metadata_.extent[0];
 }
 
 int Item::GetEpisodeLength() const {
-  if (metadata_.extent.size() > 1)
-    return metadata_.extent.at(1);
-
-  return kUnknownEpisodeLength;
+  return metadata_.extent[1];
 }
 
 int Item::GetAiringStatus(bool check_date) const {
@@ -100,9 +93,10 @@ const std::wstring& Item::GetTitle() const {
 }
 
 const std::wstring& Item::GetEnglishTitle(bool fallback) const {
-  foreach_(it, metadata_.alternative)
-    if (it->type == library::kTitleTypeLangEnglish)
-      return it->value;
+  const auto& titles = metadata_.alternative[library::kTitleTypeLangEnglish];
+
+  if (!titles.empty())
+    return titles.front();
 
   if (fallback)
     return metadata_.title;
@@ -110,35 +104,20 @@ const std::wstring& Item::GetEnglishTitle(bool fallback) const {
   return EmptyString();
 }
 
-std::vector<std::wstring> Item::GetSynonyms() const {
-  std::vector<std::wstring> synonyms;
-
-  foreach_(it, metadata_.alternative)
-    if (it->type == library::kTitleTypeSynonym)
-      synonyms.push_back(it->value);
-
-  return synonyms;
+const std::vector<std::wstring>& Item::GetSynonyms() const {
+  return metadata_.alternative[library::kTitleTypeSynonym];
 }
 
 const Date& Item::GetDateStart() const {
-  if (metadata_.date.size() > 0)
-    return metadata_.date.at(0);
-
-  return EmptyDate();
+  return metadata_.date[0];
 }
 
 const Date& Item::GetDateEnd() const {
-  if (metadata_.date.size() > 1)
-    return metadata_.date.at(1);
-
-  return EmptyDate();
+  return metadata_.date[1];
 }
 
 const std::wstring& Item::GetImageUrl() const {
-  if (metadata_.resource.size() > 0)
-    return metadata_.resource.at(0);
-
-  return EmptyString();
+  return metadata_.resource[0];
 }
 
 const std::vector<std::wstring>& Item::GetGenres() const {
@@ -146,10 +125,7 @@ const std::vector<std::wstring>& Item::GetGenres() const {
 }
 
 const std::wstring& Item::GetPopularity() const {
-  if (metadata_.community.size() > 1)
-    return metadata_.community.at(1);
-
-  return EmptyString();
+  return metadata_.community[1];
 }
 
 const std::vector<std::wstring>& Item::GetProducers() const {
@@ -157,10 +133,7 @@ const std::vector<std::wstring>& Item::GetProducers() const {
 }
 
 const std::wstring& Item::GetScore() const {
-  if (metadata_.community.size() > 0)
-    return metadata_.community.at(0);
-
-  return EmptyString();
+  return metadata_.community[0];
 }
 
 const std::wstring& Item::GetSynopsis() const {
@@ -177,14 +150,17 @@ void Item::SetId(const std::wstring& id, enum_t service) {
   if (metadata_.uid.size() < static_cast<size_t>(service) + 1)
     metadata_.uid.resize(service + 1);
 
+  if (metadata_.uid.at(service) == id)
+    return;
+
+  std::wstring previous_id = metadata_.uid.at(service);
   metadata_.uid.at(service) = id;
+
+  database_->UpdateServiceIndex(*this, service, previous_id);
 }
 
 void Item::SetSlug(const std::wstring& slug) {
-  if (metadata_.resource.size() < 2)
-    metadata_.resource.resize(2);
-
-  metadata_.resource.at(1) = slug;
+  metadata_.resource[1] = slug;
 }
 
 void Item::SetSource(enum_t source) {
@@ -196,10 +172,7 @@ void Item::SetType(int type) {
 }
 
 void Item::SetEpisodeCount(int number) {
-  if (metadata_.extent.size() < 1)
-    metadata_.extent.resize(1);
-
-  metadata_.extent.at(0) = number;
+  metadata_.extent[0] = number;
 
   // TODO: Call it separately
   if (number >= 0)
@@ -208,10 +181,7 @@ void Item::SetEpisodeCount(int number) {
 }
 
 void Item::SetEpisodeLength(int number) {
-  if (metadata_.extent.size() < 2)
-    metadata_.extent.resize(2);
-
-  metadata_.extent.at(1) = number;
+  metadata_.extent[1] = number;
 }
 
 void Item::SetAiringStatus(int status) {
@@ -223,18 +193,13 @@ void Item::SetTitle(const std::wstring& title) {
 }
 
 void Item::SetEnglishTitle(const std::wstring& title) {
-  foreach_(it, metadata_.alternative) {
-    if (it->type == library::kTitleTypeLangEnglish) {
-      it->value = title;
-      return;
-    }
-  }
-
-  library::Title new_title;
-  new_title.type = library::kTitleTypeLangEnglish;
-  new_title.value = title;
+  auto& titles = metadata_.alternative[library::kTitleTypeLangEnglish];
 
-  metadata_.alternative.push_back(new_title);
+  if (titles.empty()) {
+    titles.push_back(title);
+  } else {
+    titles.front() = title;
+  }
 }
 
 void Item::SetSynonyms(const std::wstring& synonyms) {
@@ -246,41 +211,21 @@ void Item::SetSynonyms(const std::wstring& synonyms) {
 }
 
 void Item::SetSynonyms(const std::vector<std::wstring>& synonyms) {
-  std::vector<library::Title> alternative;
-
-  foreach_(it, metadata_.alternative)
-    if (it->type != library::kTitleTypeSynonym)
-      alternative.push_back(*it);
-
-  foreach_(it, synonyms) {
-    library::Title new_title;
-    new_title.type = library::kTitleTypeSynonym;
-    new_title.value = *it;
-    alternative.push_back(new_title);
-  }
-
-  metadata_.alternative = alternative;
+  // Copied rather than assigned, so that no spare capacity is kept
+  std::vector<std::wstring>(synonyms).swap(
+      metadata_.alternative[library::kTitleTypeSynonym]);
 }
 
 void Item::SetDateStart(const Date& date) {
-  if (metadata_.date.size() < 1)
-    metadata_.date.resize(1);
-
-  metadata_.date.at(0) = date;
+  metadata_.date[0] = date;
 }
 
 void Item::SetDateEnd(const Date& date) {
-  if (metadata_.date.size() < 2)
-    metadata_.date.resize(2);
-
-  metadata_.date.at(1) = date;
+  metadata_.date[1] = date;
 }
 
 void Item::SetImageUrl(const std::wstring& url) {
-  if (metadata_.resource.size() < 1)
-    metadata_.resource.resize(1);
-
-  metadata_.resource.at(0) = url;
+  metadata_.resource[0] = url;
 }
 
 void Item::SetGenres(const std::wstring& genres) {
@@ -292,14 +237,11 @@ void Item::SetGenres(const std::wstring& genres) {
 }
 
 void Item::SetGenres(const std::vector<std::wstring>& genres) {
-  metadata_.subject = genres;
+  std::vector<std::wstring>(genres).swap(metadata_.subject);
 }
 
 void Item::SetPopularity(const std::wstring& popularity) {
-  if (metadata_.community.size() < 2)
-    metadata_.community.resize(2);
-
-  metadata_.community.at(1) = popularity;
+  metadata_.community[1] = popularity;
 }
 
 void Item::SetProducers(const std::wstring& producers) {
@@ -311,14 +253,11 @@ void Item::SetProducers(const std::wstring& producers) {
 }
 
 void Item::SetProducers(const std::vector<std::wstring>& producers) {
-  metadata_.creator = producers;
+  std::vector<std::wstring>(producers).swap(metadata_.creator);
 }
 
 void Item::SetScore(const std::wstring& score) {
-  if (metadata_.community.size() < 1)
-    metadata_.community.resize(1);
-
-  metadata_.community.at(0) = score;
+  metadata_.community[0] = score;
 }
 
 void Item::SetSynopsis(const std::wstring& synopsis) {
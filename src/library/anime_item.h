@@ -54,7 +54,7 @@ public:
   int GetAiringStatus(bool check_date = true) const;
   const std::wstring& GetTitle() const;
   const std::wstring& GetEnglishTitle(bool fallback = false) const;
-  std::vector<std::wstring> GetSynonyms() const;
+  const std::vector<std::wstring>& GetSynonyms() const;
   const Date& GetDateStart() const;
   const Date& GetDateEnd() const;
   const std::wstring& GetImageUrl() const;
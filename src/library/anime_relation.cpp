@@ -0,0 +1,147 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "base/foreach.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "base/xml.h"
+#include "library/anime_db.h"
+#include "library/anime_relation.h"
+#include "sync/manager.h"
+#include "taiga/path.h"
+#include "taiga/settings.h"
+
+anime::RelationGraph AnimeRelations;
+
+namespace anime {
+
+RelationGraph::RelationGraph()
+    : generation_(0),
+      service_(sync::kTaiga),
+      valid_(false) {
+}
+
+bool RelationGraph::Load() {
+  win::Lock lock(critical_section_);
+
+  chains_.clear();
+  index_.clear();
+  valid_ = false;
+
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnimeRelations);
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok)
+    return false;
+
+  xml_node relations_node = document.child(L"relations");
+  foreach_xmlnode_(chain_node, relations_node, L"chain") {
+    std::wstring service = chain_node.attribute(L"service").as_string();
+    Chain chain;
+    chain.service = ServiceManager.GetServiceIdByName(service);
+    foreach_xmlnode_(anime_node, chain_node, L"anime")
+      chain.ids.push_back(ToInt(anime_node.child_value()));
+    if (chain.ids.size() > 1)
+      chains_.push_back(chain);
+  }
+
+  LOG(LevelDebug, L"Chains: " + ToWstr(static_cast<int>(chains_.size())));
+
+  return true;
+}
+
+void RelationGraph::Clear() {
+  win::Lock lock(critical_section_);
+
+  chains_.clear();
+  index_.clear();
+  valid_ = false;
+}
+
+bool RelationGraph::FindSequelEpisode(int anime_id, int number,
+                                      int& sequel_id, int& sequel_number) {
+  win::Lock lock(critical_section_);
+
+  // Episode counts may have changed since the offsets were calculated
+  if (!valid_ ||
+      generation_ != AnimeDatabase.GetGeneration() ||
+      service_ != taiga::GetCurrentServiceId())
+    UpdateOffsets();
+
+  auto it = index_.find(anime_id);
+  if (it == index_.end())
+    return false;
+
+  const Chain& chain = chains_.at(it->second.first);
+  const size_t position = it->second.second;
+
+  // Find the first item that ends at or after the episode, without going past
+  // an item that is not in the database
+  const int target = chain.offsets.at(position) + number;
+  auto first = chain.offsets.begin() + position + 1;
+  auto last = chain.offsets.begin() + chain.run_ends.at(position) + 1;
+  auto offset = std::lower_bound(first, last, target);
+  if (offset == last)
+    return false;
+
+  size_t sequel = (offset - chain.offsets.begin()) - 1;
+  if (sequel == position)
+    return false;
+
+  sequel_id = chain.ids.at(sequel);
+  sequel_number = target - chain.offsets.at(sequel);
+  return true;
+}
+
+void RelationGraph::UpdateOffsets() {
+  generation_ = AnimeDatabase.GetGeneration();
+  service_ = taiga::GetCurrentServiceId();
+  index_.clear();
+
+  for (size_t i = 0; i < chains_.size(); i++) {
+    Chain& chain = chains_.at(i);
+    if (chain.service != service_)
+      continue;
+
+    const size_t size = chain.ids.size();
+    chain.offsets.assign(size + 1, 0);
+    chain.run_ends.assign(size, size);
+
+    for (size_t j = 0; j < size; j++) {
+      auto anime_item = AnimeDatabase.FindItem(chain.ids.at(j));
+      int episode_count = anime_item ? anime_item->GetEpisodeCount() : 0;
+      chain.offsets.at(j + 1) = chain.offsets.at(j) + max(episode_count, 0);
+      if (!anime_item) {
+        // Items that are not in the database break the chain
+        for (size_t k = j; k-- > 0 && chain.run_ends.at(k) == size; )
+          chain.run_ends.at(k) = j;
+        chain.run_ends.at(j) = j;
+      }
+      // An item can be a part of only one chain
+      if (!index_.count(chain.ids.at(j)))
+        index_[chain.ids.at(j)] = std::make_pair(i, j);
+    }
+  }
+
+  valid_ = true;
+}
+
+}  // namespace anime
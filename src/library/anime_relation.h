@@ -0,0 +1,76 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_LIBRARY_ANIME_RELATION_H
+#define TAIGA_LIBRARY_ANIME_RELATION_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/types.h"
+#include "win/win_thread.h"
+
+namespace anime {
+
+// Chains of prequels and sequels, read from db/anime_relations.xml. Episode
+// numbers of a chain can continue from one item to the next, as in
+// long-running series that are split into seasons.
+class RelationGraph {
+public:
+  RelationGraph();
+  ~RelationGraph() {}
+
+  bool Load();
+  void Clear();
+
+  // Resolves an episode number that goes beyond the last episode of an item
+  // to the sequel that it belongs to, and the episode number within that
+  // sequel. Safe to call from any thread.
+  bool FindSequelEpisode(int anime_id, int number,
+                         int& sequel_id, int& sequel_number);
+
+private:
+  class Chain {
+  public:
+    enum_t service;
+    std::vector<int> ids;
+    // Number of episodes before each item, beginning from the first item of
+    // the chain, with a final entry for the total
+    std::vector<int> offsets;
+    // Position of the first item after each item that is not in the database
+    std::vector<size_t> run_ends;
+  };
+
+  void UpdateOffsets();
+
+  std::vector<Chain> chains_;
+  // Mapped as <anime_id, <chain index, position in chain>>
+  std::unordered_map<int, std::pair<size_t, size_t>> index_;
+
+  win::CriticalSection critical_section_;
+  unsigned int generation_;
+  enum_t service_;
+  bool valid_;
+};
+
+}  // namespace anime
+
+extern anime::RelationGraph AnimeRelations;
+
+#endif  // TAIGA_LIBRARY_ANIME_RELATION_H
@@ -26,8 +26,10 @@
 #include "sync/sync.h"
 #include "taiga/announce.h"
 #include "taiga/path.h"
+#include "taiga/saver.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
+#include "track/recognition.h"
 #include "track/search.h"
 #include "ui/ui.h"
 
@@ -415,7 +417,7 @@ bool History::Save() {
     #undef APPEND_ATTRIBUTE_INT
   }
 
-  return XmlWriteDocumentToFile(document, path);
+  return Saver.SaveDocument(document, path);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -437,6 +439,7 @@ void ConfirmationQueue::Process() {
     anime::Episode& episode = queue_.front();
     int choice = ui::OnHistoryProcessConfirmationQueue(episode);
     if (choice != IDNO) {
+      Meow.AddAlias(episode);
       bool change_status = (choice == IDCANCEL);
       auto anime_item = AnimeDatabase.FindItem(episode.anime_id);
       AddToQueue(*anime_item, episode, change_status);
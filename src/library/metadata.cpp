@@ -20,20 +20,14 @@
 
 namespace library {
 
-Title::Title()
-    : type(kTitleTypeSynonym) {
-}
-
-Title::Title(TitleType type, const string_t& value)
-    : type(type), value(value) {
-}
-
 Metadata::Metadata()
     : audience(0),
       modified(0),
       source(0),
       status(0),
       type(0) {
+  extent[0] = 0;
+  extent[1] = 0;
 }
 
 }  // namespace library
\ No newline at end of file
@@ -27,19 +27,12 @@ namespace library {
 enum TitleType {
   kTitleTypeUnknown,
   kTitleTypeSynonym,
-  kTitleTypeLangEnglish
+  kTitleTypeLangEnglish,
+  kTitleTypeCount
 };
 
-struct Title {
-  Title();
-  Title(TitleType type, const string_t& value);
-  ~Title() {}
-
-  TitleType type;
-  string_t value;
-};
-
-// A generic metadata structure for all kinds of media
+// A generic metadata structure for all kinds of media. Fields that always have
+// the same number of values are stored inline, rather than in vectors.
 struct Metadata {
   Metadata();
   ~Metadata() {}
@@ -49,19 +42,20 @@ struct Metadata {
   time_t modified;
 
   string_t title;
-  std::vector<Title> alternative;
+  // Grouped by type, so that they can be accessed without being collected
+  std::vector<string_t> alternative[kTitleTypeCount];
 
   enum_t type;
   enum_t status;
   enum_t audience;
 
-  std::vector<unsigned short> extent;
-  std::vector<Date> date;
+  int extent[2];
+  Date date[2];
 
   std::vector<string_t> subject;
   std::vector<string_t> creator;
-  std::vector<string_t> resource;
-  std::vector<string_t> community;
+  string_t resource[2];
+  string_t community[2];
 
   string_t description;
 };
@@ -0,0 +1,1202 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cwctype>
+#include <windows.h>
+#include <psapi.h>
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+
+#include "base/foreach.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "base/time.h"
+#include "base/xml.h"
+#include "library/anime.h"
+#include "library/anime_db.h"
+#include "library/anime_episode.h"
+#include "library/anime_filter.h"
+#include "library/anime_item.h"
+#include "taiga/benchmark.h"
+#include "taiga/debug.h"
+#include "taiga/path.h"
+#include "sync/service.h"
+#include "track/recognition.h"
+
+namespace debug {
+
+BenchmarkOptions::BenchmarkOptions()
+    : iterations(10), count(0) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BenchmarkSamples::BenchmarkSamples()
+    : sorted_(true) {
+}
+
+void BenchmarkSamples::Add(double value) {
+  values_.push_back(value);
+  sorted_ = false;
+}
+
+size_t BenchmarkSamples::GetCount() const {
+  return values_.size();
+}
+
+double BenchmarkSamples::GetPercentile(double percentile) {
+  if (values_.empty())
+    return 0.0;
+
+  if (!sorted_) {
+    std::sort(values_.begin(), values_.end());
+    sorted_ = true;
+  }
+
+  // Nearest-rank method
+  size_t rank = static_cast<size_t>(percentile / 100.0 * values_.size());
+  if (rank >= values_.size())
+    rank = values_.size() - 1;
+
+  return values_.at(rank);
+}
+
+double BenchmarkSamples::GetTotal() const {
+  double total = 0.0;
+  foreach_(it, values_)
+    total += *it;
+  return total;
+}
+
+void BenchmarkSamples::Write(pugi::xml_node& node, const wchar_t* name) {
+  double total = GetTotal();
+  double mean = values_.empty() ? 0.0 : total / values_.size();
+
+  xml_node stage = node.append_child(L"stage");
+  stage.append_attribute(L"name") = name;
+  stage.append_attribute(L"count") = static_cast<unsigned int>(values_.size());
+  stage.append_attribute(L"total") = total;
+  stage.append_attribute(L"mean") = mean;
+  stage.append_attribute(L"p50") = GetPercentile(50.0);
+  stage.append_attribute(L"p90") = GetPercentile(90.0);
+  stage.append_attribute(L"p99") = GetPercentile(99.0);
+  stage.append_attribute(L"max") = GetPercentile(100.0);
+
+  LOG(LevelInformational, std::wstring(name) +
+      L" | Total: " + ToWstr(total, 2) + L"ms" +
+      L" | Mean: " + ToWstr(mean * 1000.0, 2) + L"us" +
+      L" | p50: " + ToWstr(GetPercentile(50.0) * 1000.0, 2) + L"us" +
+      L" | p99: " + ToWstr(GetPercentile(99.0) * 1000.0, 2) + L"us");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const wchar_t* corpus_groups[] = {
+  L"Coalgirls", L"Commie", L"DameDesuYo", L"Doki", L"FFF", L"gg",
+  L"HorribleSubs", L"Kametsu", L"Mazui", L"THORA", L"Underwater", L"UTW",
+  L"Vivid", L"WhyNot"
+};
+static const wchar_t* corpus_resolutions[] = {
+  L"480p", L"720p", L"1080p", L"1280x720", L"1920x1080"
+};
+static const wchar_t* corpus_video_types[] = {
+  L"H264", L"x264", L"Hi10P", L"XviD"
+};
+static const wchar_t* corpus_audio_types[] = {
+  L"AAC", L"AC3", L"FLAC"
+};
+static const wchar_t* corpus_extensions[] = {
+  L"mkv", L"mp4", L"avi"
+};
+static const wchar_t* corpus_syllables[] = {
+  L"chi", L"do", L"fu", L"ga", L"ha", L"hi", L"ka", L"ki", L"ko", L"ku",
+  L"ma", L"mi", L"mo", L"n", L"na", L"ni", L"no", L"ra", L"ri", L"ru",
+  L"sa", L"shi", L"su", L"ta", L"tsu", L"wa", L"yo", L"ze"
+};
+
+#define CORPUS_PICK(table) table[Random(ARRAYSIZE(table))]
+
+CorpusGenerator::CorpusGenerator(unsigned int seed)
+    : state_(seed ? seed : 1) {
+}
+
+// Fills in both the release name (episode.file) and the values that we expect
+// to get back from it. Release names follow the most common naming schemes.
+void CorpusGenerator::Generate(const anime::Item& anime_item,
+                               anime::Episode& episode) {
+  episode.Clear();
+  episode.anime_id = anime_item.GetId();
+
+  std::vector<std::wstring> titles;
+  titles.push_back(anime_item.GetTitle());
+  if (!anime_item.GetEnglishTitle().empty())
+    titles.push_back(anime_item.GetEnglishTitle());
+  const std::vector<std::wstring>& synonyms = anime_item.GetSynonyms();
+  titles.insert(titles.end(), synonyms.begin(), synonyms.end());
+  episode.title = titles.at(Random(titles.size()));
+
+  int episode_count = anime_item.GetEpisodeCount();
+  if (episode_count != 1) {
+    int last_episode = episode_count > 1 ? episode_count : 26;
+    int number = 1 + static_cast<int>(Random(last_episode));
+    episode.number = GenerateNumber(number, last_episode);
+    // Batch releases
+    if (number < last_episode && Random(20) == 0)
+      episode.number += L"-" + GenerateNumber(last_episode, last_episode);
+  }
+
+  episode.group = CORPUS_PICK(corpus_groups);
+  episode.resolution = CORPUS_PICK(corpus_resolutions);
+  episode.checksum = GenerateChecksum();
+  std::wstring extension = CORPUS_PICK(corpus_extensions);
+  episode.format = ToUpper_Copy(extension);
+
+  std::wstring number;
+  if (!episode.number.empty())
+    number = L" - " + episode.number;
+
+  switch (Random(4)) {
+    // [Group] Title - 01 [720p].mkv
+    case 0:
+      episode.checksum.clear();
+      episode.file = L"[" + episode.group + L"] " + episode.title + number +
+                     L" [" + episode.resolution + L"]";
+      break;
+    // [Group] Title - 01v2 [720p][ABCD1234].mkv
+    case 1:
+      if (!number.empty() && Random(2) == 0) {
+        episode.version = ToWstr(2 + static_cast<int>(Random(2)));
+        number += L"v" + episode.version;
+      }
+      episode.file = L"[" + episode.group + L"] " + episode.title + number +
+                     L" [" + episode.resolution + L"][" + episode.checksum +
+                     L"]";
+      break;
+    // [Group]_Title_-_01_[720p_H264_AAC][ABCD1234].mkv
+    case 2: {
+      episode.video_type = CORPUS_PICK(corpus_video_types);
+      episode.audio_type = CORPUS_PICK(corpus_audio_types);
+      std::wstring title = episode.title + number;
+      ReplaceChar(title, ' ', '_');
+      episode.file = L"[" + episode.group + L"]_" + title + L"_[" +
+                     episode.resolution + L"_" + episode.video_type + L"_" +
+                     episode.audio_type + L"][" + episode.checksum + L"]";
+      break;
+    }
+    // Title - 01 (720p) [Group].mkv
+    case 3:
+      episode.checksum.clear();
+      episode.file = episode.title + number + L" (" + episode.resolution +
+                     L") [" + episode.group + L"]";
+      break;
+  }
+
+  episode.file += L"." + extension;
+}
+
+// Generates a title out of random syllables, for items that don't exist
+std::wstring CorpusGenerator::GenerateTitle() {
+  std::wstring title;
+
+  size_t word_count = 1 + Random(4);
+  for (size_t i = 0; i < word_count; i++) {
+    if (i > 0)
+      title.push_back(' ');
+    std::wstring word;
+    size_t syllable_count = 1 + Random(4);
+    for (size_t j = 0; j < syllable_count; j++)
+      word += CORPUS_PICK(corpus_syllables);
+    word.at(0) = towupper(word.at(0));
+    title += word;
+  }
+
+  return title;
+}
+
+// Xorshift, so that the output doesn't depend on the standard library
+size_t CorpusGenerator::Random(size_t count) {
+  state_ ^= state_ << 13;
+  state_ ^= state_ >> 17;
+  state_ ^= state_ << 5;
+  return count ? state_ % count : 0;
+}
+
+std::wstring CorpusGenerator::GenerateChecksum() {
+  static const wchar_t digits[] = L"0123456789ABCDEF";
+
+  std::wstring checksum(8, '0');
+  for (size_t i = 0; i < checksum.size(); i++)
+    checksum.at(i) = digits[Random(16)];
+
+  return checksum;
+}
+
+std::wstring CorpusGenerator::GenerateNumber(int number, int episode_count) {
+  return PadChar(ToWstr(number), '0', episode_count < 100 ? 2 : 3);
+}
+
+#undef CORPUS_PICK
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _DEBUG
+// Only counts allocations made while the benchmark is measuring. The hook is
+// global, so the benchmark must not be run alongside other threads.
+static bool count_allocations = false;
+static unsigned int allocation_count = 0;
+
+static int __cdecl AllocationHook(int type, void* data, size_t size,
+                                  int block_type, long request,
+                                  const unsigned char* filename, int line) {
+  if (count_allocations && type == _HOOK_ALLOC && block_type != _CRT_BLOCK)
+    allocation_count++;
+  return TRUE;
+}
+#endif
+
+class RecognitionField {
+public:
+  const wchar_t* name;
+  std::wstring anime::Episode::* member;
+};
+
+static const RecognitionField recognition_fields[] = {
+  {L"title", &anime::Episode::title},
+  {L"number", &anime::Episode::number},
+  {L"group", &anime::Episode::group},
+  {L"name", &anime::Episode::name},
+  {L"version", &anime::Episode::version},
+  {L"resolution", &anime::Episode::resolution},
+  {L"audio", &anime::Episode::audio_type},
+  {L"video", &anime::Episode::video_type},
+  {L"checksum", &anime::Episode::checksum},
+  {L"extra", &anime::Episode::extras},
+  {L"format", &anime::Episode::format}
+};
+
+static bool ReadRecognitionCorpus(const std::wstring& path,
+                                  std::vector<anime::Episode>& episodes) {
+  xml_document document;
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok) {
+    LOG(LevelError, L"Could not read corpus: " + path);
+    return false;
+  }
+
+  xml_node recognition = document.child(L"recognition");
+  foreach_xmlnode_(file_node, recognition, L"file") {
+    anime::Episode episode;
+    episode.anime_id   = XmlReadIntValue(file_node, L"id");
+    episode.audio_type = XmlReadStrValue(file_node, L"audio");
+    episode.checksum   = XmlReadStrValue(file_node, L"checksum");
+    episode.extras     = XmlReadStrValue(file_node, L"extra");
+    episode.file       = XmlReadStrValue(file_node, L"file");
+    episode.format     = XmlReadStrValue(file_node, L"format");
+    episode.group      = XmlReadStrValue(file_node, L"group");
+    episode.name       = XmlReadStrValue(file_node, L"name");
+    episode.number     = XmlReadStrValue(file_node, L"number");
+    episode.resolution = XmlReadStrValue(file_node, L"resolution");
+    episode.title      = XmlReadStrValue(file_node, L"title");
+    episode.version    = XmlReadStrValue(file_node, L"version");
+    episode.video_type = XmlReadStrValue(file_node, L"video");
+    episodes.push_back(episode);
+  }
+
+  return !episodes.empty();
+}
+
+// Measures each stage of recognition separately. The engine is called
+// directly, rather than through RecognizeTitle, so that the results are not
+// affected by the recognition cache.
+static bool BenchmarkRecognition(const BenchmarkOptions& options,
+                                 xml_node& node) {
+  std::wstring input = options.input;
+  if (input.empty())
+    input = taiga::GetPath(taiga::kPathTestRecognition);
+
+  std::vector<anime::Episode> corpus;
+  if (!ReadRecognitionCorpus(input, corpus))
+    return false;
+
+  const size_t field_count = ARRAYSIZE(recognition_fields);
+  std::vector<int> field_success(field_count, 0);
+  int success_count = 0;
+  int match_count = 0, match_total = 0;
+
+  BenchmarkSamples examine_samples, clean_samples,
+                   match_samples, score_samples, total_samples;
+  ParseContext context;
+  Tester tester;
+
+#ifdef _DEBUG
+  allocation_count = 0;
+  _CRT_ALLOC_HOOK previous_hook = _CrtSetAllocHook(AllocationHook);
+#endif
+
+  for (int iteration = 0; iteration < options.iterations; iteration++) {
+    bool first_iteration = iteration == 0;
+#ifdef _DEBUG
+    count_allocations = first_iteration;
+#endif
+
+    foreach_(it, corpus) {
+      anime::Episode episode;
+      double total = 0.0;
+
+      // Tokenize and examine keywords
+      tester.Start();
+      Meow.ExamineTitle(it->file, episode, true, true, true, true, false);
+      double elapsed = tester.GetElapsed();
+      examine_samples.Add(elapsed);
+      total += elapsed;
+
+      // ExamineTitle has already cleaned the title; this is repeated only to
+      // measure the cost on its own.
+      std::wstring clean_title = episode.title;
+      tester.Start();
+      Meow.CleanTitle(clean_title);
+      clean_samples.Add(tester.GetElapsed());
+
+      // Exact match through the title index
+      tester.Start();
+      auto anime_item = Meow.MatchDatabase(episode, context,
+                                           false, true, true, true, true, false);
+      elapsed = tester.GetElapsed();
+      match_samples.Add(elapsed);
+      total += elapsed;
+
+      // Fuzzy scoring, which only happens when there's no exact match
+      if (!anime_item) {
+        tester.Start();
+        Meow.MatchDatabase(episode, context,
+                           false, true, true, true, true, true);
+        elapsed = tester.GetElapsed();
+        score_samples.Add(elapsed);
+        total += elapsed;
+      }
+
+      total_samples.Add(total);
+
+      if (!first_iteration)
+        continue;
+
+      for (size_t i = 0; i < field_count; i++) {
+        auto member = recognition_fields[i].member;
+        if (episode.*member == (*it).*member)
+          field_success.at(i)++;
+      }
+      if (episode.title == it->title && episode.number == it->number)
+        success_count++;
+      if (it->anime_id > 0) {
+        match_total++;
+        if (anime_item && anime_item->GetId() == it->anime_id)
+          match_count++;
+      }
+    }
+  }
+
+#ifdef _DEBUG
+  count_allocations = false;
+  _CrtSetAllocHook(previous_hook);
+#endif
+
+  // Write results
+  int title_count = static_cast<int>(corpus.size());
+  XmlWriteStrValue(node, L"input", input.c_str());
+  XmlWriteIntValue(node, L"titles", title_count);
+  XmlWriteIntValue(node, L"iterations", options.iterations);
+
+  double total_time = total_samples.GetTotal();
+  double throughput = total_time > 0.0 ?
+      total_samples.GetCount() / (total_time / 1000.0) : 0.0;
+  XmlWriteStrValue(node, L"throughput", ToWstr(throughput, 2).c_str());
+
+  LOG(LevelInformational, L"Titles: " + ToWstr(title_count) +
+      L" | Iterations: " + ToWstr(options.iterations) +
+      L" | Throughput: " + ToWstr(throughput, 2) + L" titles/s");
+
+  xml_node stages = node.append_child(L"stages");
+  examine_samples.Write(stages, L"examine");
+  clean_samples.Write(stages, L"clean");
+  match_samples.Write(stages, L"match");
+  score_samples.Write(stages, L"score");
+  total_samples.Write(stages, L"total");
+
+  xml_node accuracy = node.append_child(L"accuracy");
+  xml_node overall = accuracy.append_child(L"overall");
+  overall.append_attribute(L"success") = success_count;
+  overall.append_attribute(L"total") = title_count;
+  for (size_t i = 0; i < field_count; i++) {
+    xml_node field = accuracy.append_child(L"field");
+    field.append_attribute(L"name") = recognition_fields[i].name;
+    field.append_attribute(L"success") = field_success.at(i);
+    field.append_attribute(L"total") = title_count;
+  }
+  if (match_total > 0) {
+    xml_node match = accuracy.append_child(L"match");
+    match.append_attribute(L"success") = match_count;
+    match.append_attribute(L"total") = match_total;
+  }
+
+  LOG(LevelInformational, L"Success rate: " + ToWstr(success_count) + L"/" +
+      ToWstr(title_count) + (match_total > 0 ?
+      L" | Match rate: " + ToWstr(match_count) + L"/" + ToWstr(match_total) :
+      L""));
+
+#ifdef _DEBUG
+  double allocations = static_cast<double>(allocation_count) / title_count;
+  XmlWriteStrValue(node, L"allocations", ToWstr(allocations, 2).c_str());
+  LOG(LevelInformational, L"Allocations: " + ToWstr(allocations, 2) +
+                          L" per title");
+#endif
+
+  return true;
+}
+
+// Writes a synthetic corpus in the same format as data/test/recognition.xml,
+// along with the expected anime IDs.
+static bool GenerateRecognitionCorpus(const BenchmarkOptions& options) {
+  std::vector<const anime::Item*> items;
+  foreach_(it, AnimeDatabase.items)
+    items.push_back(&it->second);
+
+  if (items.empty()) {
+    LOG(LevelError, L"Anime database is empty.");
+    return false;
+  }
+
+  int count = options.count ? options.count : 1000;
+  CorpusGenerator generator(1);
+
+  xml_document document;
+  xml_node recognition = document.append_child(L"recognition");
+
+  for (int i = 0; i < count; i++) {
+    anime::Episode episode;
+    generator.Generate(*items.at(generator.Random(items.size())), episode);
+
+    xml_node file_node = recognition.append_child(L"file");
+    XmlWriteStrValue(file_node, L"file", episode.file.c_str());
+    XmlWriteIntValue(file_node, L"id", episode.anime_id);
+    for (size_t j = 0; j < ARRAYSIZE(recognition_fields); j++) {
+      const std::wstring& value = episode.*recognition_fields[j].member;
+      if (!value.empty())
+        XmlWriteStrValue(file_node, recognition_fields[j].name, value.c_str());
+    }
+  }
+
+  std::wstring output = options.output;
+  if (output.empty())
+    output = taiga::GetPath(taiga::kPathTest) + L"recognition_synthetic.xml";
+
+  LOG(LevelInformational, L"Generated " + ToWstr(count) + L" names: " + output);
+
+  return XmlWriteDocumentToFile(document, output);
+}
+
+// Fills the database with made-up items. These are never saved to the user's
+// files, as the application exits without saving after running a benchmark.
+static void FillDatabase(size_t database_size, CorpusGenerator& generator) {
+  int anime_id = AnimeDatabase.items.empty() ?
+      1 : AnimeDatabase.items.rbegin()->first + 1;
+  while (AnimeDatabase.items.size() < database_size) {
+    anime::Item& anime_item = AnimeDatabase.items[anime_id];
+    anime_item.SetId(ToWstr(anime_id), sync::kTaiga);
+    anime_item.SetSource(sync::kTaiga);
+    anime_item.SetTitle(generator.GenerateTitle());
+    anime_item.SetType(anime::kTv);
+    anime_item.SetEpisodeCount(12 * (1 + anime_id % 4));
+    anime_item.SetAiringStatus(anime::kFinishedAiring);
+    anime_id++;
+  }
+}
+
+// Recognizes a large number of generated names against a database of at least
+// 20,000 items. Names are generated one at a time, rather than being kept in
+// memory.
+static bool BenchmarkScale(const BenchmarkOptions& options, xml_node& node) {
+  const size_t database_size = 20000;
+  CorpusGenerator generator(1);
+
+  FillDatabase(database_size, generator);
+
+  Tester tester;
+  tester.Start();
+  Meow.InvalidateCleanTitles();
+  Meow.UpdateCleanTitles();
+  double index_time = tester.GetElapsed();
+
+  std::vector<const anime::Item*> items;
+  foreach_(it, AnimeDatabase.items)
+    items.push_back(&it->second);
+
+  int count = options.count ? options.count : 1000000;
+  int success_count = 0, match_count = 0;
+
+  BenchmarkSamples examine_samples, match_samples, score_samples,
+                   total_samples;
+  ParseContext context;
+
+  for (int i = 0; i < count; i++) {
+    anime::Episode expected;
+    generator.Generate(*items.at(generator.Random(items.size())), expected);
+
+    anime::Episode episode;
+    double total = 0.0;
+
+    tester.Start();
+    Meow.ExamineTitle(expected.file, episode, true, true, true, true, false);
+    double elapsed = tester.GetElapsed();
+    examine_samples.Add(elapsed);
+    total += elapsed;
+
+    tester.Start();
+    auto anime_item = Meow.MatchDatabase(episode, context,
+                                         false, true, true, true, true, false);
+    elapsed = tester.GetElapsed();
+    match_samples.Add(elapsed);
+    total += elapsed;
+
+    if (!anime_item) {
+      tester.Start();
+      Meow.MatchDatabase(episode, context,
+                         false, true, true, true, true, true);
+      elapsed = tester.GetElapsed();
+      score_samples.Add(elapsed);
+      total += elapsed;
+    }
+
+    total_samples.Add(total);
+
+    if (episode.title == expected.title && episode.number == expected.number)
+      success_count++;
+    if (anime_item && anime_item->GetId() == expected.anime_id)
+      match_count++;
+  }
+
+  // Write results
+  int database_count = static_cast<int>(AnimeDatabase.items.size());
+  XmlWriteIntValue(node, L"database", database_count);
+  XmlWriteIntValue(node, L"titles", count);
+  XmlWriteStrValue(node, L"index", ToWstr(index_time, 2).c_str());
+
+  double total_time = total_samples.GetTotal();
+  double throughput = total_time > 0.0 ? count / (total_time / 1000.0) : 0.0;
+  XmlWriteStrValue(node, L"throughput", ToWstr(throughput, 2).c_str());
+
+  LOG(LevelInformational, L"Database: " + ToWstr(database_count) +
+      L" | Titles: " + ToWstr(count) +
+      L" | Index: " + ToWstr(index_time, 2) + L"ms" +
+      L" | Throughput: " + ToWstr(throughput, 2) + L" titles/s");
+
+  xml_node stages = node.append_child(L"stages");
+  examine_samples.Write(stages, L"examine");
+  match_samples.Write(stages, L"match");
+  score_samples.Write(stages, L"score");
+  total_samples.Write(stages, L"total");
+
+  xml_node accuracy = node.append_child(L"accuracy");
+  xml_node overall = accuracy.append_child(L"overall");
+  overall.append_attribute(L"success") = success_count;
+  overall.append_attribute(L"total") = count;
+  xml_node match = accuracy.append_child(L"match");
+  match.append_attribute(L"success") = match_count;
+  match.append_attribute(L"total") = count;
+
+  LOG(LevelInformational, L"Success rate: " + ToWstr(success_count) + L"/" +
+      ToWstr(count) + L" | Match rate: " + ToWstr(match_count) + L"/" +
+      ToWstr(count));
+
+  return true;
+}
+
+// Loads a database of at least 20,000 items from its XML file and from its
+// binary snapshot, which are written to the test folder beforehand.
+static bool BenchmarkLoad(const BenchmarkOptions& options, xml_node& node) {
+  const size_t database_size = 20000;
+  CorpusGenerator generator(1);
+
+  FillDatabase(database_size, generator);
+
+  std::wstring path = taiga::GetPath(taiga::kPathTest) + L"benchmark_anime.xml";
+  // The saver is not running in benchmark mode, so the file is written by the
+  // time SaveDatabase returns
+  if (!AnimeDatabase.SaveDatabase(path)) {
+    LOG(LevelError, L"Could not write database: " + path);
+    return false;
+  }
+
+  BenchmarkSamples xml_samples, snapshot_samples;
+  size_t xml_count = 0, snapshot_count = 0;
+  Tester tester;
+
+  for (int i = 0; i < options.iterations; i++) {
+    AnimeDatabase.items.clear();
+    tester.Start();
+    AnimeDatabase.LoadDatabase(path, false);
+    xml_samples.Add(tester.GetElapsed());
+    xml_count = AnimeDatabase.items.size();
+
+    AnimeDatabase.items.clear();
+    tester.Start();
+    bool loaded = AnimeDatabase.LoadDatabase(path, true);
+    snapshot_samples.Add(tester.GetElapsed());
+    snapshot_count = loaded ? AnimeDatabase.items.size() : 0;
+  }
+
+  // Write results
+  XmlWriteIntValue(node, L"database", static_cast<int>(xml_count));
+  XmlWriteIntValue(node, L"snapshot", static_cast<int>(snapshot_count));
+
+  xml_node stages = node.append_child(L"stages");
+  xml_samples.Write(stages, L"xml");
+  snapshot_samples.Write(stages, L"snapshot");
+
+  LOG(LevelInformational, L"Items: " + ToWstr(static_cast<int>(xml_count)) +
+      L" | XML: " + ToWstr(xml_samples.GetPercentile(50.0), 2) + L"ms" +
+      L" | Snapshot: " + ToWstr(snapshot_samples.GetPercentile(50.0), 2) +
+      L"ms");
+
+  // The snapshot is skipped if it's outdated, which would make the results
+  // meaningless
+  if (snapshot_count != xml_count) {
+    LOG(LevelError, L"Snapshot could not be loaded.");
+    return false;
+  }
+
+  return true;
+}
+
+// Imports a made-up list of 10,000 items through Database::UpdateItem, the way
+// a service would after downloading the user's library, and then imports it
+// once more to update the same items. Items are identified by their
+// MyAnimeList IDs, which are outside the range of real ones. Finally, another
+// list of items that only have Hummingbird IDs is imported, for which new IDs
+// have to be generated.
+static bool BenchmarkImport(const BenchmarkOptions& options, xml_node& node) {
+  const int first_id = 10000000;
+  const int batch_size = 1000;
+  int count = options.count ? options.count : 10000;
+  CorpusGenerator generator(1);
+
+  std::vector<anime::Item> list(count);
+  std::vector<anime::Item> unknown_list(count);
+  for (int i = 0; i < count * 2; i++) {
+    anime::Item& anime_item =
+        i < count ? list.at(i) : unknown_list.at(i - count);
+    if (i < count) {
+      anime_item.SetId(ToWstr(first_id + i), sync::kMyAnimeList);
+      anime_item.SetSource(sync::kMyAnimeList);
+    } else {
+      anime_item.SetId(L"benchmark-" + ToWstr(i), sync::kHummingbird);
+      anime_item.SetSource(sync::kHummingbird);
+    }
+    anime_item.SetTitle(generator.GenerateTitle());
+    anime_item.SetType(anime::kTv);
+    anime_item.SetEpisodeCount(12 * (1 + i % 4));
+    anime_item.SetAiringStatus(anime::kFinishedAiring);
+    anime_item.SetLastModified(1);
+    anime_item.AddtoUserList();
+    anime_item.SetMyStatus(anime::kCompleted);
+    anime_item.SetMyLastWatchedEpisode(anime_item.GetEpisodeCount());
+  }
+
+  const wchar_t* pass_names[] = {L"import", L"update", L"allocate"};
+  const int pass_count = ARRAYSIZE(pass_names);
+  BenchmarkSamples pass_samples[pass_count];
+  xml_node batches = node.append_child(L"batches");
+  int database_count = static_cast<int>(AnimeDatabase.items.size());
+  Tester tester;
+
+  for (int pass = 0; pass < pass_count; pass++) {
+    const auto& items = pass < 2 ? list : unknown_list;
+    double batch_time = 0.0;
+    for (int i = 0; i < count; i++) {
+      tester.Start();
+      AnimeDatabase.UpdateItem(items.at(i));
+      double elapsed = tester.GetElapsed();
+      pass_samples[pass].Add(elapsed);
+      batch_time += elapsed;
+
+      // Times should stay flat as the database grows
+      if ((i + 1) % batch_size == 0 || i + 1 == count) {
+        xml_node batch = batches.append_child(L"batch");
+        batch.append_attribute(L"pass") = pass_names[pass];
+        batch.append_attribute(L"items") = i + 1;
+        batch.append_attribute(L"total") = batch_time;
+        batch_time = 0.0;
+      }
+    }
+  }
+
+  // Write results
+  XmlWriteIntValue(node, L"database", database_count);
+  XmlWriteIntValue(node, L"items", count);
+
+  xml_node stages = node.append_child(L"stages");
+  for (int pass = 0; pass < pass_count; pass++) {
+    pass_samples[pass].Write(stages, pass_names[pass]);
+    LOG(LevelInformational, std::wstring(pass_names[pass]) + L": " +
+        ToWstr(pass_samples[pass].GetTotal(), 2) + L"ms | p99: " +
+        ToWstr(pass_samples[pass].GetPercentile(99.0), 4) + L"ms");
+  }
+
+  return true;
+}
+
+// Estimates the memory that is allocated for a string. Strings of up to 7
+// characters are stored inline, as in the short string optimization of MSVC.
+static size_t EstimateStringMemory(const std::wstring& str) {
+  const size_t allocation_overhead = sizeof(void*) * 2;
+
+  if (str.capacity() <= 7)
+    return 0;
+
+  return (str.capacity() + 1) * sizeof(wchar_t) + allocation_overhead;
+}
+
+static size_t EstimateStringsMemory(const std::vector<std::wstring>& strings) {
+  const size_t allocation_overhead = sizeof(void*) * 2;
+  size_t size = 0;
+
+  if (strings.capacity())
+    size += strings.capacity() * sizeof(std::wstring) + allocation_overhead;
+  foreach_(it, strings)
+    size += EstimateStringMemory(*it);
+
+  return size;
+}
+
+// Estimates the memory of an item by following the layout of
+// library::Metadata. Library data is not included, as most items in the
+// database are not in the user's list.
+static size_t EstimateItemMemory(const anime::Item& item) {
+  const size_t allocation_overhead = sizeof(void*) * 2;
+  size_t size = sizeof(anime::Item);
+
+  // IDs are kept in a vector, with a value for each service
+  size += (sync::kLastService + 1) * sizeof(std::wstring) +
+          allocation_overhead;
+  for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++)
+    size += EstimateStringMemory(item.GetId(i));
+
+  size += EstimateStringMemory(item.GetSlug());
+  size += EstimateStringMemory(item.GetTitle());
+  // English title is kept in a vector of its own, once it's set
+  size += sizeof(std::wstring) + allocation_overhead +
+          EstimateStringMemory(item.GetEnglishTitle());
+  size += EstimateStringsMemory(item.GetSynonyms());
+  size += EstimateStringMemory(item.GetImageUrl());
+  size += EstimateStringsMemory(item.GetGenres());
+  size += EstimateStringsMemory(item.GetProducers());
+  size += EstimateStringMemory(item.GetScore());
+  size += EstimateStringMemory(item.GetPopularity());
+  size += EstimateStringMemory(item.GetSynopsis());
+
+  return size;
+}
+
+// Returns the memory that is committed to the process and can't be shared
+// with other processes, which includes everything allocated on the heap.
+static SIZE_T GetPrivateBytes() {
+  PROCESS_MEMORY_COUNTERS_EX counters = {0};
+  counters.cb = sizeof(counters);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(),
+          reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+          sizeof(counters)))
+    return 0;
+  return counters.PrivateUsage;
+}
+
+static std::wstring GenerateText(CorpusGenerator& generator, size_t words) {
+  std::wstring text;
+  for (size_t i = 0; i < words; i++) {
+    if (i > 0)
+      text += L" ";
+    text += generator.GenerateTitle();
+  }
+  return text;
+}
+
+// Fills a database of 20,000 items with made-up metadata, and reports how much
+// memory an item takes up, both as measured by the increase in private bytes
+// and as estimated from the layout. Then a text filter is applied to every
+// item, as it is when the anime list is filtered.
+static bool BenchmarkMemory(const BenchmarkOptions& options, xml_node& node) {
+  const size_t database_size = 20000;
+  CorpusGenerator generator(1);
+
+  // Items are created from scratch, so that all of their memory is measured
+  AnimeDatabase.items.clear();
+  SIZE_T private_bytes = GetPrivateBytes();
+
+  FillDatabase(database_size, generator);
+
+#ifdef _DEBUG
+  allocation_count = 0;
+  _CRT_ALLOC_HOOK previous_hook = _CrtSetAllocHook(AllocationHook);
+#endif
+
+  foreach_(it, AnimeDatabase.items) {
+    anime::Item& anime_item = it->second;
+
+    // Values are generated beforehand, so that only the allocations that are
+    // made by the item are counted
+    std::wstring english_title = generator.GenerateTitle();
+    std::vector<std::wstring> synonyms(generator.Random(3));
+    foreach_(synonym, synonyms)
+      *synonym = generator.GenerateTitle();
+    std::vector<std::wstring> genres(1 + generator.Random(4));
+    foreach_(genre, genres)
+      *genre = generator.GenerateTitle();
+    std::vector<std::wstring> producers(1 + generator.Random(2));
+    foreach_(producer, producers)
+      *producer = GenerateText(generator, 2);
+    std::wstring slug = L"anime-" + ToWstr(it->first);
+    std::wstring image_url = L"http://cdn.example.com/images/anime/" +
+                             ToWstr(it->first) + L".jpg";
+    std::wstring score = ToWstr(static_cast<int>(generator.Random(10))) +
+                         L"." + ToWstr(static_cast<int>(generator.Random(100)));
+    std::wstring popularity = L"#" + ToWstr(it->first);
+    std::wstring synopsis = GenerateText(generator, 40 + generator.Random(80));
+    Date date_start(static_cast<unsigned short>(1990 + generator.Random(25)),
+                    static_cast<unsigned short>(1 + generator.Random(12)),
+                    static_cast<unsigned short>(1 + generator.Random(28)));
+    Date date_end = date_start;
+    date_end.month = static_cast<unsigned short>(
+        date_start.month < 10 ? date_start.month + 3 : 12);
+
+#ifdef _DEBUG
+    count_allocations = true;
+#endif
+    anime_item.SetSlug(slug);
+    anime_item.SetEnglishTitle(english_title);
+    anime_item.SetSynonyms(synonyms);
+    anime_item.SetEpisodeLength(24);
+    anime_item.SetDateStart(date_start);
+    anime_item.SetDateEnd(date_end);
+    anime_item.SetImageUrl(image_url);
+    anime_item.SetGenres(genres);
+    anime_item.SetProducers(producers);
+    anime_item.SetScore(score);
+    anime_item.SetPopularity(popularity);
+    anime_item.SetSynopsis(synopsis);
+#ifdef _DEBUG
+    count_allocations = false;
+#endif
+  }
+
+#ifdef _DEBUG
+  _CrtSetAllocHook(previous_hook);
+#endif
+
+  SIZE_T private_bytes_after = GetPrivateBytes();
+  private_bytes = private_bytes_after > private_bytes ?
+      private_bytes_after - private_bytes : 0;
+
+  size_t total_size = 0;
+  foreach_(it, AnimeDatabase.items)
+    total_size += EstimateItemMemory(it->second);
+
+  // Nothing matches the text, so that every field is checked
+  anime::Filters filters;
+  filters.text = L"_ _";
+
+  BenchmarkSamples filter_samples;
+  Tester tester;
+  for (int i = 0; i < options.iterations; i++) {
+    tester.Start();
+    foreach_(it, AnimeDatabase.items)
+      filters.CheckItem(it->second);
+    filter_samples.Add(tester.GetElapsed());
+  }
+
+  // Write results
+  int item_count = static_cast<int>(AnimeDatabase.items.size());
+  double measured_bytes = static_cast<double>(private_bytes) / item_count;
+  double estimated_bytes = static_cast<double>(total_size) / item_count;
+  XmlWriteIntValue(node, L"database", item_count);
+  XmlWriteIntValue(node, L"item_size", static_cast<int>(sizeof(anime::Item)));
+  XmlWriteStrValue(node, L"measured_item_bytes",
+                   ToWstr(measured_bytes, 2).c_str());
+  XmlWriteStrValue(node, L"estimated_item_bytes",
+                   ToWstr(estimated_bytes, 2).c_str());
+
+  xml_node stages = node.append_child(L"stages");
+  filter_samples.Write(stages, L"filter");
+
+  LOG(LevelInformational, L"Items: " + ToWstr(item_count) +
+      L" | Item size: " + ToWstr(static_cast<int>(sizeof(anime::Item))) +
+      L" bytes | Measured: " + ToWstr(measured_bytes, 2) +
+      L" bytes per item | Estimated: " + ToWstr(estimated_bytes, 2) +
+      L" bytes per item | Filter: " + ToWstr(filter_samples.GetPercentile(50.0), 2) + L"ms");
+
+#ifdef _DEBUG
+  double allocations = static_cast<double>(allocation_count) / item_count;
+  XmlWriteStrValue(node, L"allocations", ToWstr(allocations, 2).c_str());
+  LOG(LevelInformational, L"Allocations: " + ToWstr(allocations, 2) +
+                          L" per item");
+#endif
+
+  return true;
+}
+
+// Makes a random string of the given length. Small alphabets result in more
+// matches, while large ones result in more collisions in the pattern table.
+static std::wstring GenerateString(CorpusGenerator& generator, size_t length,
+                                   size_t alphabet_size) {
+  std::wstring str(length, L' ');
+  foreach_(it, str)
+    *it = static_cast<wchar_t>(L'a' + generator.Random(alphabet_size));
+  return str;
+}
+
+// Makes a few random edits, so that the strings compared are similar
+static std::wstring MutateString(CorpusGenerator& generator,
+                                 const std::wstring& str,
+                                 size_t alphabet_size) {
+  std::wstring result = str;
+  size_t edit_count = generator.Random(4);
+  for (size_t i = 0; i < edit_count; i++) {
+    wchar_t c = static_cast<wchar_t>(L'a' + generator.Random(alphabet_size));
+    size_t pos = generator.Random(result.length() + 1);
+    switch (generator.Random(3)) {
+      case 0:
+        result.insert(pos, 1, c);
+        break;
+      case 1:
+        if (pos < result.length())
+          result.erase(pos, 1);
+        break;
+      case 2:
+        if (pos < result.length())
+          result.at(pos) = c;
+        break;
+    }
+  }
+  return result;
+}
+
+// Compares the bit-parallel string metrics with their classic versions, which
+// they replace for strings of up to 64 characters. Strings are chosen around
+// that limit, along with empty strings and single characters. Fails if any of
+// the results differ.
+static bool BenchmarkMetrics(const BenchmarkOptions& options, xml_node& node) {
+  static const size_t lengths[] = {0, 1, 2, 7, 32, 63, 64, 65, 100, 200};
+  static const size_t alphabet_sizes[] = {1, 2, 4, 26, 1000};
+  const size_t length_count = sizeof(lengths) / sizeof(*lengths);
+  const size_t alphabet_count =
+      sizeof(alphabet_sizes) / sizeof(*alphabet_sizes);
+
+  CorpusGenerator generator(1);
+  int count = options.count ? options.count : 100000;
+  int lcs_errors = 0, substr_errors = 0, distance_errors = 0;
+  double time = 0.0, classic_time = 0.0;
+  Tester tester;
+
+  for (int i = 0; i < count; i++) {
+    size_t alphabet_size = alphabet_sizes[generator.Random(alphabet_count)];
+    std::wstring str1 = GenerateString(
+        generator, lengths[generator.Random(length_count)], alphabet_size);
+    std::wstring str2 = generator.Random(2) ?
+        MutateString(generator, str1, alphabet_size) :
+        GenerateString(generator, lengths[generator.Random(length_count)],
+                       alphabet_size);
+
+    tester.Start();
+    size_t lcs = LongestCommonSubsequenceLength(str1, str2);
+    size_t substr = LongestCommonSubstringLength(str1, str2);
+    size_t distance = LevenshteinDistance(str1, str2);
+    time += tester.GetElapsed();
+
+    tester.Start();
+    size_t classic_lcs = ClassicLongestCommonSubsequenceLength(str1, str2);
+    size_t classic_substr = ClassicLongestCommonSubstringLength(str1, str2);
+    size_t classic_distance = ClassicLevenshteinDistance(str1, str2);
+    classic_time += tester.GetElapsed();
+
+    if (lcs != classic_lcs)
+      lcs_errors++;
+    if (substr != classic_substr)
+      substr_errors++;
+    if (distance != classic_distance)
+      distance_errors++;
+
+    if (lcs != classic_lcs || substr != classic_substr ||
+        distance != classic_distance)
+      LOG(LevelError, L"Mismatch: \"" + str1 + L"\", \"" + str2 + L"\" | " +
+          L"LCS: " + ToWstr(static_cast<int>(lcs)) + L"/" +
+          ToWstr(static_cast<int>(classic_lcs)) + L" | " +
+          L"Substring: " + ToWstr(static_cast<int>(substr)) + L"/" +
+          ToWstr(static_cast<int>(classic_substr)) + L" | " +
+          L"Distance: " + ToWstr(static_cast<int>(distance)) + L"/" +
+          ToWstr(static_cast<int>(classic_distance)));
+  }
+
+  // Write results
+  XmlWriteIntValue(node, L"pairs", count);
+  xml_node errors = node.append_child(L"errors");
+  errors.append_attribute(L"lcs") = lcs_errors;
+  errors.append_attribute(L"substring") = substr_errors;
+  errors.append_attribute(L"distance") = distance_errors;
+  XmlWriteStrValue(node, L"time", ToWstr(time, 2).c_str());
+  XmlWriteStrValue(node, L"classic_time", ToWstr(classic_time, 2).c_str());
+
+  LOG(LevelInformational, L"Pairs: " + ToWstr(count) +
+      L" | Errors: " + ToWstr(lcs_errors + substr_errors + distance_errors) +
+      L" | Time: " + ToWstr(time, 2) + L"ms" +
+      L" | Classic: " + ToWstr(classic_time, 2) + L"ms");
+
+  return lcs_errors == 0 && substr_errors == 0 && distance_errors == 0;
+}
+
+// Estimates the size of the clean titles as they were kept before, in a map of
+// vectors with an allocation per title. Strings of up to 7 characters are
+// stored inline, as in the short string optimization of MSVC.
+static size_t EstimateCleanTitleNodeMemory(const CleanTitleStore& store) {
+  const size_t allocation_overhead = sizeof(void*) * 2;
+  const size_t map_node_size = sizeof(void*) * 3 + sizeof(int) * 2 +
+                               sizeof(std::vector<std::wstring>);
+  size_t size = 0;
+
+  std::vector<int> ids;
+  std::vector<std::wstring> titles;
+  store.GetIds(ids);
+  foreach_(id, ids) {
+    store.GetTitles(*id, titles);
+    size += map_node_size + allocation_overhead;
+    if (!titles.empty())
+      size += titles.capacity() * sizeof(std::wstring) + allocation_overhead;
+    foreach_(title, titles)
+      if (title->length() > 7)
+        size += (title->length() + 1) * sizeof(wchar_t) + allocation_overhead;
+  }
+
+  return size;
+}
+
+static void WriteCleanTitleMemory(xml_node& node) {
+  const CleanTitleStore& store = Meow.clean_titles();
+  size_t store_size = store.GetMemoryUsage();
+  size_t node_size = EstimateCleanTitleNodeMemory(store);
+
+  xml_node memory = node.append_child(L"clean_titles");
+  memory.append_attribute(L"items") = static_cast<int>(store.item_count());
+  memory.append_attribute(L"titles") = static_cast<int>(store.title_count());
+  memory.append_attribute(L"bytes") = static_cast<double>(store_size);
+  memory.append_attribute(L"node_bytes") = static_cast<double>(node_size);
+
+  LOG(LevelInformational, L"Clean titles: " +
+      ToWstr(static_cast<int>(store.title_count())) + L" titles | Memory: " +
+      ToWstr(static_cast<double>(store_size) / 1024.0, 2) + L" KiB | " +
+      L"Estimated with node storage: " +
+      ToWstr(static_cast<double>(node_size) / 1024.0, 2) + L" KiB");
+}
+
+// Engine counters break the examine stage down further
+static void WriteRecognitionStats(xml_node& node) {
+  const RecognitionStats& stats = Meow.stats();
+
+  xml_node engine = node.append_child(L"engine");
+  engine.append_attribute(L"titles") = static_cast<double>(stats.titles);
+  engine.append_attribute(L"tokens") = static_cast<double>(stats.tokens);
+  engine.append_attribute(L"keyword_hits") =
+      static_cast<double>(stats.keyword_hits);
+  engine.append_attribute(L"alias_matches") =
+      static_cast<double>(stats.alias_matches);
+  engine.append_attribute(L"exact_matches") =
+      static_cast<double>(stats.exact_matches);
+  engine.append_attribute(L"scored_matches") =
+      static_cast<double>(stats.scored_matches);
+  engine.append_attribute(L"failed_matches") =
+      static_cast<double>(stats.failed_matches);
+  engine.append_attribute(L"candidates_scored") =
+      static_cast<double>(stats.candidates_scored);
+  engine.append_attribute(L"candidates_skipped") =
+      static_cast<double>(stats.candidates_skipped);
+
+  std::wstring text;
+  for (int i = 0; i < kStageCount; i++) {
+    std::wstring name = RecognitionStats::GetStageName(i);
+    xml_node stage = engine.append_child(L"stage");
+    stage.append_attribute(L"name") = name.c_str();
+    stage.append_attribute(L"total") = stats.GetTime(i);
+    text += L" | " + name + L": " + ToWstr(stats.GetTime(i), 2) + L"ms";
+  }
+  LOG(LevelInformational, L"Engine" + text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RunBenchmark(const BenchmarkOptions& options) {
+  LOG(LevelInformational, L"Benchmark: " + options.name);
+
+  // Writes its output in the format of the input of other benchmarks
+  if (options.name == L"corpus")
+    return GenerateRecognitionCorpus(options);
+
+  xml_document document;
+  xml_node node = document.append_child(L"benchmark");
+  node.append_attribute(L"name") = options.name.c_str();
+  node.append_attribute(L"date") = std::wstring(GetDate()).c_str();
+  node.append_attribute(L"time") = GetTime().c_str();
+
+  bool result = false;
+  Meow.ResetStats();
+
+  if (options.name == L"recognition") {
+    result = BenchmarkRecognition(options, node);
+  } else if (options.name == L"scale") {
+    result = BenchmarkScale(options, node);
+  } else if (options.name == L"import") {
+    result = BenchmarkImport(options, node);
+  } else if (options.name == L"load") {
+    result = BenchmarkLoad(options, node);
+  } else if (options.name == L"memory") {
+    result = BenchmarkMemory(options, node);
+  } else if (options.name == L"metrics") {
+    result = BenchmarkMetrics(options, node);
+  } else {
+    LOG(LevelError, L"Unknown benchmark: " + options.name);
+    return false;
+  }
+
+  if (!result) {
+    LOG(LevelError, L"Benchmark failed: " + options.name);
+    return false;
+  }
+
+  // Other benchmarks don't go through the recognition engine, so its figures
+  // would be empty or left over from loading
+  if (options.name == L"recognition" || options.name == L"scale") {
+    WriteRecognitionStats(node);
+    WriteCleanTitleMemory(node);
+  }
+
+  std::wstring output = options.output;
+  if (output.empty())
+    output = taiga::GetPath(taiga::kPathTest) +
+             L"benchmark_" + options.name + L".xml";
+
+  return XmlWriteDocumentToFile(document, output);
+}
+
+}  // namespace debug
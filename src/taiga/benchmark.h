@@ -0,0 +1,88 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TAIGA_BENCHMARK_H
+#define TAIGA_TAIGA_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+namespace anime {
+class Episode;
+class Item;
+}
+namespace pugi {
+class xml_node;
+}
+
+namespace debug {
+
+// Benchmarks are run from the command line, without creating any windows:
+//   Taiga.exe -benchmark <name> [-input <path>] [-output <path>]
+//             [-iterations <count>] [-count <count>]
+// Results are written to an XML file, so that they can be compared between
+// builds.
+class BenchmarkOptions {
+public:
+  BenchmarkOptions();
+
+  std::wstring name;
+  std::wstring input;
+  std::wstring output;
+  int iterations;
+  int count;
+};
+
+// Keeps a sample of measurements, in milliseconds
+class BenchmarkSamples {
+public:
+  BenchmarkSamples();
+
+  void Add(double value);
+  size_t GetCount() const;
+  double GetPercentile(double percentile);
+  double GetTotal() const;
+  void Write(pugi::xml_node& node, const wchar_t* name);
+
+private:
+  bool sorted_;
+  std::vector<double> values_;
+};
+
+bool RunBenchmark(const BenchmarkOptions& options);
+
+// Builds release names from the titles in the anime database, with known
+// results. Output is deterministic for a given seed and database.
+class CorpusGenerator {
+public:
+  CorpusGenerator(unsigned int seed);
+
+  void Generate(const anime::Item& anime_item, anime::Episode& episode);
+  std::wstring GenerateTitle();
+  size_t Random(size_t count);
+
+private:
+  std::wstring GenerateChecksum();
+  std::wstring GenerateNumber(int number, int episode_count);
+
+  unsigned int state_;
+};
+
+}  // namespace debug
+
+#endif  // TAIGA_TAIGA_BENCHMARK_H
@@ -52,6 +52,14 @@ void Tester::End(std::wstring str, bool display_result) {
   }
 }
 
+// Returns the time since Start() in milliseconds
+double Tester::GetElapsed() const {
+  LARGE_INTEGER li;
+
+  ::QueryPerformanceCounter(&li);
+  return double(li.QuadPart - value_) / frequency_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Print(std::wstring text) {
@@ -29,6 +29,7 @@ class Tester {
 
   void Start();
   void End(std::wstring str, bool display_result);
+  double GetElapsed() const;
 
  private:
   double frequency_;
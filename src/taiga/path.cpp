@@ -56,6 +56,10 @@ std::wstring GetPath(PathType type) {
       return data_path + L"db\\";
     case kPathDatabaseAnime:
       return data_path + L"db\\anime.xml";
+    case kPathDatabaseAnimeRelations:
+      return data_path + L"db\\anime_relations.xml";
+    case kPathDatabaseAnimeTitles:
+      return data_path + L"db\\anime_titles.xml";
     case kPathDatabaseImage:
       return data_path + L"db\\image\\";
     case kPathDatabaseSeason:
@@ -66,6 +70,10 @@ std::wstring GetPath(PathType type) {
       return data_path + L"feed\\history.xml";
     case kPathMedia:
       return data_path + L"media.xml";
+    case kPathRecognitionStats:
+      return data_path + L"recognition_stats.xml";
+    case kPathSaverStats:
+      return data_path + L"saver_stats.xml";
     case kPathSettings:
       return data_path + L"settings.xml";
     case kPathTest:
@@ -78,10 +86,14 @@ std::wstring GetPath(PathType type) {
       return data_path + L"theme\\" + Settings[kApp_Interface_Theme] + L"\\theme.xml";
     case kPathUser:
       return data_path + L"user\\";
+    case kPathUserAliases:
+      return data_path + L"user\\" + GetUserDirectoryName() + L"\\aliases.xml";
     case kPathUserHistory:
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\history.xml";
     case kPathUserLibrary:
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.xml";
+    case kPathUserLibraryJournal:
+      return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.journal";
   }
 }
 
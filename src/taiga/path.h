@@ -27,19 +27,25 @@ enum PathType {
   kPathData,
   kPathDatabase,
   kPathDatabaseAnime,
+  kPathDatabaseAnimeRelations,
+  kPathDatabaseAnimeTitles,
   kPathDatabaseImage,
   kPathDatabaseSeason,
   kPathFeed,
   kPathFeedHistory,
   kPathMedia,
+  kPathRecognitionStats,
+  kPathSaverStats,
   kPathSettings,
   kPathTest,
   kPathTestRecognition,
   kPathTheme,
   kPathThemeCurrent,
   kPathUser,
+  kPathUserAliases,
   kPathUserHistory,
-  kPathUserLibrary
+  kPathUserLibrary,
+  kPathUserLibraryJournal
 };
 
 std::wstring GetPath(PathType type);
@@ -0,0 +1,344 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/file.h"
+#include "base/foreach.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "taiga/path.h"
+#include "taiga/saver.h"
+#include "taiga/taiga.h"
+
+taiga::Saver Saver;
+
+namespace taiga {
+
+// Long enough for a burst of changes to settle, short enough that not much
+// is lost if the process is terminated
+static const DWORD kCoalescingWindow = 500;  // milliseconds
+
+static __int64 GetPerformanceCounter() {
+  LARGE_INTEGER li;
+  ::QueryPerformanceCounter(&li);
+  return li.QuadPart;
+}
+
+// Returns the time since the given counter value, in milliseconds
+static double GetElapsedTime(__int64 since) {
+  LARGE_INTEGER frequency;
+  ::QueryPerformanceFrequency(&frequency);
+
+  return static_cast<double>(GetPerformanceCounter() - since) * 1000.0 /
+         static_cast<double>(frequency.QuadPart);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SaveRequest::SaveRequest()
+    : append(false),
+      time_requested_(0) {
+}
+
+bool SaveRequest::Write() {
+  DWORD length = static_cast<DWORD>(data.size());
+
+  bool result = append ? ::AppendToFile(data.data(), length, path) :
+                         SaveToFileAtomic(data.data(), length, path);
+
+  if (result && !obsolete_path.empty())
+    ::DeleteFile(obsolete_path.c_str());
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SaverStats::SaverStats() {
+  Reset();
+}
+
+void SaverStats::Reset() {
+  requests = 0;
+  coalesced = 0;
+  writes = 0;
+  failures = 0;
+  latency_total = 0.0;
+  latency_max = 0.0;
+  write_time_total = 0.0;
+  write_time_max = 0.0;
+}
+
+bool SaverStats::Save(const std::wstring& path) const {
+  xml_document document;
+  xml_node stats_node = document.append_child(L"saver_stats");
+
+  #define XML_WI(n, v) \
+    XmlWriteIntValue(stats_node, n, static_cast<int>(v))
+  #define XML_WD(n, v) \
+    XmlWriteStrValue(stats_node, n, ToWstr(v, 2).c_str())
+  XML_WI(L"requests", requests);
+  XML_WI(L"coalesced", coalesced);
+  XML_WI(L"writes", writes);
+  XML_WI(L"failures", failures);
+  XML_WD(L"latency_total", latency_total);
+  XML_WD(L"latency_max", latency_max);
+  XML_WD(L"write_time_total", write_time_total);
+  XML_WD(L"write_time_max", write_time_max);
+  #undef XML_WD
+  #undef XML_WI
+
+  return XmlWriteDocumentToFile(document, path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Saver::Saver()
+    : flush_event_(nullptr),
+      idle_event_(nullptr),
+      request_event_(nullptr),
+      stopping_(false) {
+}
+
+Saver::~Saver() {
+  Stop();
+
+  foreach_(it, requests_)
+    delete *it;
+
+  if (flush_event_)
+    ::CloseHandle(flush_event_);
+  if (idle_event_)
+    ::CloseHandle(idle_event_);
+  if (request_event_)
+    ::CloseHandle(request_event_);
+}
+
+bool Saver::Start() {
+  if (GetThreadHandle())
+    return true;
+
+  if (!request_event_) {
+    flush_event_ = ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    idle_event_ = ::CreateEvent(nullptr, TRUE, TRUE, nullptr);
+    request_event_ = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  }
+  if (!flush_event_ || !idle_event_ || !request_event_)
+    return false;
+
+  stopping_ = false;
+
+  return CreateThread(nullptr, 0, 0);
+}
+
+void Saver::Stop() {
+  if (!GetThreadHandle())
+    return;
+
+  // Signal worker thread to stop, once the pending requests are written
+  {
+    win::Lock lock(critical_section_);
+    stopping_ = true;
+  }
+  ::SetEvent(flush_event_);
+  ::SetEvent(request_event_);
+
+  // Wait for thread to stop
+  ::WaitForSingleObject(GetThreadHandle(), INFINITE);
+
+  // Clean up
+  CloseThreadHandle();
+  ::ResetEvent(flush_event_);
+
+  ReportFailures();
+}
+
+void Saver::Flush() {
+  if (!GetThreadHandle())
+    return;
+
+  // Skip the coalescing window, and wait until the queue is empty
+  ::SetEvent(flush_event_);
+  ::SetEvent(request_event_);
+  ::WaitForSingleObject(idle_event_, INFINITE);
+  ::ResetEvent(flush_event_);
+
+  ReportFailures();
+}
+
+DWORD Saver::ThreadProc() {
+  while (true) {
+    ::WaitForSingleObject(request_event_, INFINITE);
+
+    // Requests that are made in the meantime replace the pending ones, unless
+    // we're asked to write them right away
+    ::WaitForSingleObject(flush_event_, kCoalescingWindow);
+
+    WritePendingRequests();
+
+    win::Lock lock(critical_section_);
+    if (stopping_ && requests_.empty())
+      break;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Saver::Save(SaveRequest* request) {
+  request->time_requested_ = GetPerformanceCounter();
+
+  if (!GetThreadHandle()) {
+    {
+      win::Lock lock(critical_section_);
+      stats_.requests++;
+    }
+    return Write(request);
+  }
+
+  win::Lock lock(critical_section_);
+
+  stats_.requests++;
+
+  if (request->append) {
+    // Consecutive appends to the same file are merged
+    if (!requests_.empty()) {
+      SaveRequest* last_request = requests_.back();
+      if (last_request->append && last_request->path == request->path &&
+          last_request->obsolete_path.empty()) {
+        last_request->data.append(request->data);
+        stats_.coalesced++;
+        delete request;
+        return true;
+      }
+    }
+  } else {
+    // The pending request is replaced by the new one, which is queued at the
+    // end, so that it's written after any appends that were made in between.
+    // Latency is still measured from the first request.
+    foreach_(it, requests_) {
+      if (!(*it)->append && (*it)->path == request->path) {
+        request->time_requested_ = (*it)->time_requested_;
+        delete *it;
+        requests_.erase(it);
+        stats_.coalesced++;
+        break;
+      }
+    }
+  }
+
+  requests_.push_back(request);
+  ::ResetEvent(idle_event_);
+  ::SetEvent(request_event_);
+
+  return true;
+}
+
+bool Saver::SaveDocument(const xml_document& document,
+                         const std::wstring& path) {
+  SaveRequest* request = new SaveRequest;
+  request->path = path;
+  XmlWriteDocumentToString(document, request->data);
+
+  return Save(request);
+}
+
+bool Saver::AppendToFile(const std::string& data, const std::wstring& path) {
+  SaveRequest* request = new SaveRequest;
+  request->path = path;
+  request->data = data;
+  request->append = true;
+
+  return Save(request);
+}
+
+SaverStats Saver::GetStats() {
+  win::Lock lock(critical_section_);
+  return stats_;
+}
+
+bool Saver::SaveStats() {
+  return GetStats().Save(GetPath(kPathSaverStats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Callers have long returned by the time a queued request fails, so the user
+// is told about it the next time the queue is flushed
+void Saver::ReportFailures() {
+  std::vector<std::wstring> paths;
+  {
+    win::Lock lock(critical_section_);
+    paths.swap(failed_paths_);
+  }
+  if (paths.empty())
+    return;
+
+  std::wstring text = L"Could not save the following files:\n";
+  foreach_(it, paths)
+    text += L"\n" + *it;
+  ::MessageBox(nullptr, text.c_str(), TAIGA_APP_TITLE, MB_OK | MB_ICONERROR);
+}
+
+bool Saver::Write(SaveRequest* request) {
+  __int64 time_started = GetPerformanceCounter();
+  bool result = request->Write();
+  double write_time = GetElapsedTime(time_started);
+  double latency = GetElapsedTime(request->time_requested_);
+
+  if (!result)
+    LOG(LevelError, L"Could not write file: " + request->path);
+
+  {
+    win::Lock lock(critical_section_);
+    stats_.writes++;
+    if (!result)
+      stats_.failures++;
+    stats_.latency_total += latency;
+    stats_.latency_max = max(stats_.latency_max, latency);
+    stats_.write_time_total += write_time;
+    stats_.write_time_max = max(stats_.write_time_max, write_time);
+  }
+
+  delete request;
+
+  return result;
+}
+
+void Saver::WritePendingRequests() {
+  while (true) {
+    SaveRequest* request = nullptr;
+    {
+      win::Lock lock(critical_section_);
+      if (requests_.empty()) {
+        // Nothing is left to write, and nothing is being written
+        ::SetEvent(idle_event_);
+        return;
+      }
+      request = requests_.front();
+      requests_.erase(requests_.begin());
+    }
+    std::wstring path = request->path;
+    if (!Write(request)) {
+      win::Lock lock(critical_section_);
+      failed_paths_.push_back(path);
+    }
+  }
+}
+
+}  // namespace taiga
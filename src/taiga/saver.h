@@ -0,0 +1,124 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TAIGA_SAVER_H
+#define TAIGA_TAIGA_SAVER_H
+
+#include <string>
+#include <vector>
+
+#include "base/xml.h"
+#include "win/win_thread.h"
+
+namespace taiga {
+
+// Holds a copy of everything that is to be written, taken on the main thread,
+// so that the worker thread never touches data that the main thread owns.
+class SaveRequest {
+public:
+  SaveRequest();
+  virtual ~SaveRequest() {}
+
+  // Called on the worker thread. Files are replaced atomically, so a crash in
+  // the middle of a write leaves the previous version intact.
+  virtual bool Write();
+
+  std::wstring path;
+  std::string data;
+
+  // Data is appended to the file, rather than replacing it
+  bool append;
+  // Deleted once the file is written, if the file now includes its contents
+  std::wstring obsolete_path;
+
+private:
+  friend class Saver;
+  __int64 time_requested_;
+};
+
+// Times are kept in milliseconds
+class SaverStats {
+public:
+  SaverStats();
+  ~SaverStats() {}
+
+  void Reset();
+  bool Save(const std::wstring& path) const;
+
+  size_t requests;
+  size_t coalesced;  // Replaced or merged before they were written
+  size_t writes;
+  size_t failures;
+  double latency_total;  // From the request until the file is written
+  double latency_max;
+  double write_time_total;
+  double write_time_max;
+};
+
+// Writes files on a worker thread, so that the main thread is not blocked by
+// the disk. Requests for the same file that are made in quick succession are
+// coalesced, and only the last one is written.
+class Saver : public win::Thread {
+public:
+  Saver();
+  ~Saver();
+
+  // Worker thread
+  DWORD ThreadProc();
+
+  // Main thread
+  bool Start();
+  // Writes every pending request before stopping
+  void Stop();
+  // Blocks until every pending request is written, e.g. before a file that
+  // may have a pending request is read
+  void Flush();
+
+  // Takes ownership of the request. Returns true once the request is queued,
+  // which doesn't mean that it will be written successfully; failures are
+  // logged, and reported to the user on the next Flush or Stop. If the worker
+  // thread is not running, the request is written right away, and the result
+  // of the write is returned.
+  bool Save(SaveRequest* request);
+  bool SaveDocument(const xml_document& document, const std::wstring& path);
+  bool AppendToFile(const std::string& data, const std::wstring& path);
+
+  SaverStats GetStats();
+  bool SaveStats();
+
+private:
+  void ReportFailures();
+  bool Write(SaveRequest* request);
+  void WritePendingRequests();
+
+  win::CriticalSection critical_section_;
+  // Paths of queued requests that could not be written
+  std::vector<std::wstring> failed_paths_;
+  std::vector<SaveRequest*> requests_;
+  HANDLE flush_event_;
+  HANDLE idle_event_;
+  HANDLE request_event_;
+  bool stopping_;
+  SaverStats stats_;
+};
+
+}  // namespace taiga
+
+extern taiga::Saver Saver;
+
+#endif  // TAIGA_TAIGA_SAVER_H
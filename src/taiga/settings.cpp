@@ -27,6 +27,7 @@
 #include "library/resource.h"
 #include "sync/manager.h"
 #include "taiga/path.h"
+#include "taiga/saver.h"
 #include "taiga/settings.h"
 #include "taiga/stats.h"
 #include "taiga/taiga.h"
@@ -34,6 +35,7 @@
 #include "taiga/version.h"
 #include "track/media.h"
 #include "track/monitor.h"
+#include "track/recognition.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
 #include "ui/ui.h"
@@ -144,6 +146,7 @@ void AppSettings::InitializeMap() {
   INITKEY(kStream_Veoh, nullptr, L"recognition/streaming/providers/veoh");
   INITKEY(kStream_Viz, nullptr, L"recognition/streaming/providers/viz");
   INITKEY(kStream_Youtube, nullptr, L"recognition/streaming/providers/youtube");
+  INITKEY(kRecognition_ScoreCandidateLimit, L"100", L"recognition/score/candidatelimit");
 
   // Sharing
   INITKEY(kShare_Http_Enabled, nullptr, L"announce/http/enabled");
@@ -233,6 +236,7 @@ bool AppSettings::Load() {
     anime_item->SetUserSynonyms(item.attribute(L"titles").value());
     anime_item->SetUseAlternative(item.attribute(L"use_alternative").as_bool());
   }
+  Meow.InvalidateCleanTitles();
 
   // Media players
   xml_node node_players = settings.child(L"recognition").child(L"mediaplayers");
@@ -388,7 +392,7 @@ bool AppSettings::Save() {
   reg.CloseKey();
 
   std::wstring path = taiga::GetPath(taiga::kPathSettings);
-  return XmlWriteDocumentToFile(document, path);
+  return ::Saver.SaveDocument(document, path);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -426,7 +430,10 @@ void AppSettings::ApplyChanges(const std::wstring& previous_service,
 
   bool changed_username = GetCurrentUsername() != previous_user;
   if (changed_username || changed_service) {
+    // Files of the previous user may still be waiting to be written
+    ::Saver.Flush();
     AnimeDatabase.LoadList();
+    Meow.LoadAliases();
     History.Load();
     CurrentEpisode.Set(anime::ID_UNKNOWN);
     Stats.CalculateAll();
@@ -443,6 +450,9 @@ void AppSettings::ApplyChanges(const std::wstring& previous_service,
   ui::Menus.UpdateExternalLinks();
 
   timers.UpdateIntervalsFromSettings();
+
+  // Recognition results depend on some of the settings (e.g. root folders)
+  Meow.ClearCache();
 }
 
 void AppSettings::HandleCompatibility() {
@@ -88,6 +88,7 @@ enum AppSettingName {
   kStream_Veoh,
   kStream_Viz,
   kStream_Youtube,
+  kRecognition_ScoreCandidateLimit,
 
   // Sharing
   kShare_Http_Enabled,
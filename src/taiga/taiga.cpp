@@ -20,15 +20,18 @@
 #include "base/process.h"
 #include "base/string.h"
 #include "library/anime_db.h"
+#include "library/anime_relation.h"
 #include "library/history.h"
 #include "taiga/announce.h"
 #include "taiga/api.h"
 #include "taiga/dummy.h"
 #include "taiga/resource.h"
+#include "taiga/saver.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "taiga/version.h"
 #include "track/media.h"
+#include "track/recognition.h"
 #include "ui/dialog.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
@@ -85,9 +88,18 @@ BOOL App::InitInstance() {
   // Load data
   LoadData();
 
+  // Run benchmark and exit, without creating any windows
+  if (!benchmark.name.empty()) {
+    debug::RunBenchmark(benchmark);
+    return FALSE;
+  }
+
   DummyAnime.Initialize();
   DummyEpisode.Initialize();
 
+  // Start writing files in the background
+  ::Saver.Start();
+
   // Create API windows
   ::Skype.Create();
   TaigaApi.Create();
@@ -117,7 +129,14 @@ void App::Uninitialize() {
   // Save
   Settings.Save();
   AnimeDatabase.SaveDatabase();
+  AnimeDatabase.CompactList();
+  Meow.SaveCleanTitles();
+  if (debug_mode)
+    Meow.SaveStats();
   Aggregator.SaveArchive();
+  ::Saver.Stop();
+  if (debug_mode)
+    ::Saver.SaveStats();
 
   // Exit
   PostQuitMessage();
@@ -137,6 +156,16 @@ void App::ParseCommandLineArguments() {
       debug_mode = true;
       Logger.SetSeverityLevel(LevelDebug);
       LOG(LevelDebug, argument);
+    } else if (argument == L"-benchmark" && i + 1 < argument_count) {
+      benchmark.name = argument_list[++i];
+    } else if (argument == L"-input" && i + 1 < argument_count) {
+      benchmark.input = argument_list[++i];
+    } else if (argument == L"-output" && i + 1 < argument_count) {
+      benchmark.output = argument_list[++i];
+    } else if (argument == L"-iterations" && i + 1 < argument_count) {
+      benchmark.iterations = max(1, ToInt(argument_list[++i]));
+    } else if (argument == L"-count" && i + 1 < argument_count) {
+      benchmark.count = max(1, ToInt(argument_list[++i]));
     }
   }
 
@@ -155,6 +184,13 @@ void App::LoadData() {
   AnimeDatabase.LoadDatabase();
   AnimeDatabase.LoadList();
   AnimeDatabase.ClearInvalidItems();
+  AnimeRelations.Load();
+
+  // Clean titles are built now rather than on the first recognition, using
+  // the ones that were saved on the last run where possible
+  Meow.LoadCleanTitles();
+  Meow.UpdateCleanTitles();
+  Meow.LoadAliases();
 
   History.Load();
 }
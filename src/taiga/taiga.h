@@ -20,6 +20,7 @@
 #define TAIGA_TAIGA_TAIGA_H
 
 #include "base/version.h"
+#include "taiga/benchmark.h"
 #include "taiga/update.h"
 #include "win/win_main.h"
 
@@ -58,6 +59,7 @@ public:
   bool debug_mode;
   bool logged_in;
   base::SemanticVersion version;
+  debug::BenchmarkOptions benchmark;
 
   class Updater : public UpdateHelper {
   public:
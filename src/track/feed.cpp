@@ -150,11 +150,17 @@ bool Feed::Download(int index) {
 }
 
 bool Feed::ExamineData() {
+  // Examine titles and compare with anime list items
+  std::vector<std::wstring> titles;
+  std::vector<anime::Episode> episodes;
+  titles.reserve(items.size());
+  foreach_(it, items)
+    titles.push_back(it->title);
+  Meow.ExamineTitles(titles, episodes, false, true, true);
+
+  size_t index = 0;
   foreach_(it, items) {
-    // Examine title and compare with anime list items
-    Meow.ExamineTitle(it->title, it->episode_data,
-                      true, true, true, true, false);
-    Meow.MatchDatabase(it->episode_data, true, true);
+    static_cast<anime::Episode&>(it->episode_data) = episodes.at(index++);
 
     // Update last aired episode number
     if (it->episode_data.anime_id > anime::ID_UNKNOWN) {
@@ -270,6 +276,50 @@ bool Aggregator::SearchArchive(const std::wstring& file) {
   return false;
 }
 
+void Aggregator::AddToChecksumIndex(const anime::Episode& episode) {
+  if (episode.checksum.empty() || episode.anime_id <= anime::ID_UNKNOWN)
+    return;
+
+  DownloadedEpisode downloaded_episode;
+  downloaded_episode.checksum = ToUpper_Copy(episode.checksum);
+  downloaded_episode.anime_id = episode.anime_id;
+  downloaded_episode.number = episode.number;
+
+  auto it = checksum_index_.find(downloaded_episode.checksum);
+  if (it != checksum_index_.end()) {
+    downloaded_episodes_.at(it->second) = downloaded_episode;
+  } else {
+    checksum_index_[downloaded_episode.checksum] = downloaded_episodes_.size();
+    downloaded_episodes_.push_back(downloaded_episode);
+  }
+}
+
+bool Aggregator::SearchChecksumIndex(anime::Episode& episode) const {
+  if (episode.checksum.empty() || checksum_index_.empty())
+    return false;
+
+  auto it = checksum_index_.find(ToUpper_Copy(episode.checksum));
+  if (it == checksum_index_.end())
+    return false;
+
+  const DownloadedEpisode& downloaded_episode =
+      downloaded_episodes_.at(it->second);
+  if (!AnimeDatabase.FindItem(downloaded_episode.anime_id))
+    return false;
+
+  episode.anime_id = downloaded_episode.anime_id;
+  if (!downloaded_episode.number.empty())
+    episode.number = downloaded_episode.number;
+
+  return true;
+}
+
+void Aggregator::RebuildChecksumIndex() {
+  checksum_index_.clear();
+  for (size_t i = 0; i < downloaded_episodes_.size(); i++)
+    checksum_index_[downloaded_episodes_.at(i).checksum] = i;
+}
+
 void Aggregator::HandleFeedCheck(Feed& feed, bool automatic) {
   feed.Load();
 
@@ -292,6 +342,7 @@ void Aggregator::HandleFeedDownload(Feed& feed, bool download_all) {
   auto feed_item = reinterpret_cast<FeedItem*>(&feed.items.at(feed.download_index));
 
   file_archive.push_back(feed_item->title);
+  AddToChecksumIndex(feed_item->episode_data);
 
   std::wstring file = feed_item->title;
   ValidateFileName(file);
@@ -445,6 +496,19 @@ bool Aggregator::LoadArchive() {
     file_archive.push_back(node.attribute(L"title").value());
   }
 
+  // Read downloaded
+  downloaded_episodes_.clear();
+  xml_node checksums_node = document.child(L"checksums");
+  foreach_xmlnode_(node, checksums_node, L"item") {
+    DownloadedEpisode downloaded_episode;
+    downloaded_episode.checksum = ToUpper_Copy(node.attribute(L"checksum").value());
+    downloaded_episode.anime_id = node.attribute(L"id").as_int();
+    downloaded_episode.number = node.attribute(L"episode").value();
+    if (!downloaded_episode.checksum.empty())
+      downloaded_episodes_.push_back(downloaded_episode);
+  }
+  RebuildChecksumIndex();
+
   return true;
 }
 
@@ -465,6 +529,24 @@ bool Aggregator::SaveArchive() {
     }
   }
 
+  xml_node checksums_node = document.append_child(L"checksums");
+
+  if (max_count > 0) {
+    size_t length = downloaded_episodes_.size();
+    size_t i = 0;
+    if (length > max_count)
+      i = length - max_count;
+    for ( ; i < downloaded_episodes_.size(); i++) {
+      const DownloadedEpisode& downloaded_episode = downloaded_episodes_[i];
+      xml_node xml_item = checksums_node.append_child(L"item");
+      xml_item.append_attribute(L"checksum") =
+          downloaded_episode.checksum.c_str();
+      xml_item.append_attribute(L"id") = downloaded_episode.anime_id;
+      xml_item.append_attribute(L"episode") =
+          downloaded_episode.number.c_str();
+    }
+  }
+
   std::wstring path = taiga::GetPath(taiga::kPathFeedHistory);
   return XmlWriteDocumentToFile(document, path);
 }
@@ -20,6 +20,7 @@
 #define TAIGA_TRACK_FEED_H
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "library/anime_episode.h"
@@ -124,6 +125,16 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// An episode that was downloaded through a feed, identified by its checksum
+class DownloadedEpisode {
+public:
+  DownloadedEpisode() : anime_id(0) {}
+
+  std::wstring checksum;
+  int anime_id;
+  std::wstring number;
+};
+
 class Aggregator {
 public:
   Aggregator();
@@ -141,12 +152,23 @@ public:
   bool SaveArchive();
   bool SearchArchive(const std::wstring& file);
 
+  void AddToChecksumIndex(const anime::Episode& episode);
+  // Sets the anime ID and number of a file that was downloaded before
+  bool SearchChecksumIndex(anime::Episode& episode) const;
+
   std::vector<Feed> feeds;
   std::vector<std::wstring> file_archive;
   FeedFilterManager filter_manager;
 
 private:
   bool CompareFeedItems(const GenericFeedItem& item1, const GenericFeedItem& item2);
+  void RebuildChecksumIndex();
+
+  // Kept in the order they were downloaded, so that the oldest ones can be
+  // dropped along with the archive
+  std::vector<DownloadedEpisode> downloaded_episodes_;
+  // Mapped as <uppercase checksum, index in downloaded_episodes_>
+  std::unordered_map<std::wstring, size_t> checksum_index_;
 };
 
 extern Aggregator Aggregator;
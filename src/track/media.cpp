@@ -297,9 +297,12 @@ void ProcessMediaPlayerTitle(const MediaPlayer& media_player) {
     if (!Settings.GetBool(taiga::kApp_Option_EnableRecognition))
       return;
     // Examine title and compare it with list items
-    if (Meow.ExamineTitle(MediaPlayers.current_title(), CurrentEpisode)) {
-      anime_item = Meow.MatchDatabase(CurrentEpisode,
-                                      false, true, true, true, true, true);
+    ParseOptions parse_options;
+    parse_options.in_list = false;
+    parse_options.give_score = true;
+    if (Meow.RecognizeTitle(MediaPlayers.current_title(), CurrentEpisode,
+                            parse_options)) {
+      anime_item = AnimeDatabase.FindItem(CurrentEpisode.anime_id);
       if (anime_item) {
         // Recognized
         MediaPlayers.set_title_changed(false);
@@ -24,6 +24,7 @@
 #include "library/anime_episode.h"
 #include "library/anime_util.h"
 #include "taiga/settings.h"
+#include "track/feed.h"
 #include "track/monitor.h"
 #include "track/recognition.h"
 #include "track/search.h"
@@ -354,9 +355,22 @@ void FolderMonitor::HandleAnime(const std::wstring& path,
 
   // Examine path and compare with list items
   anime::Episode episode;
-  if (Meow.ExamineTitle(path, episode)) {
-    if (anime_id == anime::ID_UNKNOWN || change_info.type == kPathTypeFile) {
-      auto anime_item = Meow.MatchDatabase(episode, true, true, true, false, false);
+  ParseOptions parse_options;
+  bool match_database = anime_id == anime::ID_UNKNOWN ||
+                        change_info.type == kPathTypeFile;
+  parse_options.match_database = false;
+  parse_options.check_episode = false;
+  parse_options.check_date = false;
+  if (Meow.RecognizeTitle(path, episode, parse_options)) {
+    if (match_database) {
+      // Files that were downloaded through a feed are known by their checksum,
+      // so we only need to go through the database for the others
+      if (!Aggregator.SearchChecksumIndex(episode))
+        Meow.MatchDatabase(episode, parse_options.in_list,
+                           parse_options.reverse, parse_options.strict,
+                           parse_options.check_episode,
+                           parse_options.check_date);
+      auto anime_item = AnimeDatabase.FindItem(episode.anime_id);
       if (anime_item)
         anime_id = anime_item->GetId();
     }
@@ -16,19 +16,35 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <functional>
+
 #include "base/foreach.h"
 #include "base/string.h"
+#include "base/xml.h"
 #include "library/anime_db.h"
 #include "library/anime_episode.h"
+#include "library/anime_relation.h"
 #include "library/anime_util.h"
+#include "taiga/path.h"
 #include "taiga/resource.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "track/media.h"
 #include "track/recognition.h"
+#include "win/win_thread.h"
 
 RecognitionEngine Meow;
 
+// Must be changed whenever CleanTitle produces a different output, so that
+// outdated clean titles are not loaded from the disk
+static const wchar_t* clean_title_cache_version = L"1";
+
+// Tokens own a copy of their part of the title, as their content is modified
+// when keywords are erased and tokens are combined. Words within a token are
+// visited as ranges instead (see ExamineToken).
 class Token {
 public:
   Token() : encloser('\0'), separator('\0'), untouched(true) {}
@@ -39,7 +55,63 @@ public:
   bool untouched;
 };
 
-RecognitionEngine::RecognitionEngine() {
+// Maps characters to what they are equivalent to in clean titles, and tells
+// which characters are removed from them. Romanizations that expand into more
+// than one character are handled by RecognitionEngine::FoldTitle.
+class TitleFoldingTable {
+public:
+  TitleFoldingTable() {
+    for (int c = 0; c < kSize; c++) {
+      chars_[c] = static_cast<wchar_t>(c);
+      // Control codes, white-space and punctuation characters
+      punctuation_[c] = !isalnum(c);
+    }
+    chars_[0x00E9] = L'e';  // small e acute accent
+    chars_[0x00D7] = L'x';  // multiplication symbol
+  }
+
+  wchar_t Fold(wchar_t c) const {
+    if (c < kSize)
+      return chars_[c];
+    switch (c) {
+      case L'\uFF0F': return L'/';  // unicode slash
+      case L'\uFF5E': return L'~';  // unicode tilde
+      case L'\u223C': return L'~';  // unicode tilde 2
+      case L'\u301C': return L'~';  // unicode tilde 3
+      case L'\uFF1F': return L'?';  // unicode question mark
+      case L'\uFF01': return L'!';  // unicode exclamation point
+      case L'\u2715': return L'x';  // multiplication symbol 2
+    }
+    return c;
+  }
+
+  // Expects a folded character
+  bool IsPunctuation(wchar_t c) const {
+    if (c < kSize)
+      return punctuation_[c];
+    // Unicode stars, hearts, notes, etc. (0x2000-0x2767)
+    return c > 8192 && c < 10087;
+  }
+
+  // Expects a folded character
+  bool IsTrailing(wchar_t c) const {
+    return c == L'!' ||  // "Hayate no Gotoku!", "K-ON!"...
+           c == L'+' ||  // "Needless+"
+           c == L'\'';   // "Gintama'"
+  }
+
+private:
+  static const int kSize = 256;
+
+  wchar_t chars_[kSize];
+  bool punctuation_[kSize];
+};
+
+static const TitleFoldingTable title_folding_table;
+
+RecognitionEngine::RecognitionEngine()
+    : title_index_valid_(false),
+      clean_title_cache_modified_(false) {
   ReadKeyword(audio_keywords,
       L"2CH, 5.1CH, 5.1, AAC, AC3, DTS, DTS5.1, DTS-ES, DUALAUDIO, DUAL AUDIO, "
       L"FLAC, MP3, OGG, TRUEHD5.1, VORBIS");
@@ -61,6 +133,92 @@ RecognitionEngine::RecognitionEngine() {
       L"EPISODE, EP., EP, VOLUME, VOL., VOL, EPS., EPS");
   ReadKeyword(episode_prefixes,
       L"EP., EP, E, VOL., VOL, EPS., \x7B2C");
+
+  episode_patterns_.Compile(episode_prefixes);
+
+  // Compile all keyword lists into a single table, so that each word is looked
+  // up only once
+  AddKeywords(audio_keywords, kKeywordAudio);
+  AddKeywords(video_keywords, kKeywordVideo);
+  AddKeywords(extra_keywords, kKeywordExtra);
+  AddKeywords(extra_unsafe_keywords, kKeywordExtraUnsafe);
+  AddKeywords(version_keywords, kKeywordVersion);
+  AddKeywords(valid_extensions, kKeywordExtension);
+  AddKeywords(episode_keywords, kKeywordEpisode);
+  AddKeywords(episode_prefixes, kKeywordEpisodePrefix);
+}
+
+// Orders scores from best to worst. Equal scores are ordered by ID, so that
+// results don't depend on the order in which items are scored.
+static bool IsBetterScore(const std::pair<int, int>& score1,
+                          const std::pair<int, int>& score2) {
+  if (score1.first != score2.first)
+    return score1.first > score2.first;
+  return score1.second < score2.second;
+}
+
+ParseContext::ParseContext()
+    : score_limit(10) {
+}
+
+void ParseContext::Reset() {
+  scores.clear();
+}
+
+bool ParseContext::AddScore(int anime_id, int score) {
+  auto item = std::make_pair(score, anime_id);
+
+  if (scores.size() < score_limit) {
+    scores.push_back(item);
+    std::push_heap(scores.begin(), scores.end(), IsBetterScore);
+    return true;
+  }
+
+  if (scores.empty() || !IsBetterScore(item, scores.front()))
+    return false;
+
+  std::pop_heap(scores.begin(), scores.end(), IsBetterScore);
+  scores.back() = item;
+  std::push_heap(scores.begin(), scores.end(), IsBetterScore);
+
+  return true;
+}
+
+int ParseContext::GetScoreThreshold() const {
+  if (scores.size() < score_limit || scores.empty())
+    return INT_MIN;
+
+  return scores.front().first;
+}
+
+ParseOptions::ParseOptions()
+    : examine_inside(true),
+      examine_outside(true),
+      examine_number(true),
+      check_extras(true),
+      check_extension(true),
+      match_database(true),
+      in_list(true),
+      reverse(true),
+      strict(true),
+      check_episode(true),
+      check_date(true),
+      give_score(false) {
+}
+
+unsigned int ParseOptions::GetFlags() const {
+  const bool options[] = {
+    examine_inside, examine_outside, examine_number, check_extras,
+    check_extension, match_database, in_list, reverse, strict, check_episode,
+    check_date, give_score
+  };
+
+  unsigned int flags = 0;
+  for (size_t i = 0; i < ARRAYSIZE(options); i++)
+    if (options[i])
+      flags |= 1 << i;
+
+  return flags;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -72,24 +230,127 @@ anime::Item* RecognitionEngine::MatchDatabase(anime::Episode& episode,
                                               bool check_episode,
                                               bool check_date,
                                               bool give_score) {
+  return MatchDatabase(episode, context_, in_list, reverse, strict,
+                       check_episode, check_date, give_score);
+}
+
+anime::Item* RecognitionEngine::MatchDatabase(anime::Episode& episode,
+                                              ParseContext& context,
+                                              bool in_list,
+                                              bool reverse,
+                                              bool strict,
+                                              bool check_episode,
+                                              bool check_date,
+                                              bool give_score) {
+  RecognitionStopwatch stopwatch;
+
+  auto anime_item = FindMatchingItem(episode, context, in_list, reverse, strict,
+                                     check_episode, check_date, give_score);
+
+  stopwatch.Lap(stats_, kStageMatch);
+  if (anime_item) {
+    RecognitionStats::Add(strict ? stats_.exact_matches :
+                                   stats_.partial_matches);
+  } else if (!context.scores.empty()) {
+    RecognitionStats::Add(stats_.scored_matches);
+  } else {
+    RecognitionStats::Add(stats_.failed_matches);
+  }
+
+  return anime_item;
+}
+
+anime::Item* RecognitionEngine::FindMatchingItem(anime::Episode& episode,
+                                                 ParseContext& context,
+                                                 bool in_list,
+                                                 bool reverse,
+                                                 bool strict,
+                                                 bool check_episode,
+                                                 bool check_date,
+                                                 bool give_score) {
   // Reset scores
-  foreach_(it, scores)
-    it->second = 0;
+  context.Reset();
+
+  // Leave if title is empty
+  if (episode.clean_title.empty())
+    return nullptr;
+
+  // Make sure that every item is in the title index
+  if (!title_index_valid_)
+    UpdateCleanTitles();
+
+  // Titles that the user has confirmed before are resolved without
+  // comparing titles. If the episode doesn't fit the item anymore, we fall back
+  // to the usual way.
+  int alias_id = FindAlias(episode.clean_title);
+  if (alias_id > anime::ID_UNKNOWN) {
+    auto anime_item = AnimeDatabase.FindItem(alias_id);
+    if (anime_item && (!in_list || anime_item->IsInList()) &&
+        (!check_date || anime::IsAiredYet(*anime_item)) &&
+        MatchEpisodeNumber(episode, *anime_item, check_episode)) {
+      RecognitionStats::Add(stats_.alias_matches);
+      return AnimeDatabase.FindItem(episode.anime_id);
+    }
+  }
+
+  // In strict mode, titles can only match if they are equal, so we only need to
+  // compare the episode with the items that we find in the title index.
+  if (strict) {
+    std::set<int> candidates;
+    FindTitleCandidates(episode, candidates);
+
+    if (reverse) {
+      foreach_r_(it, candidates) {
+        auto anime_item = AnimeDatabase.FindItem(*it);
+        if (!anime_item || (in_list && !anime_item->IsInList()))
+          continue;
+        if (CompareEpisode(episode, *anime_item, context, strict,
+                           check_episode, check_date, false))
+          return AnimeDatabase.FindItem(episode.anime_id);
+      }
+    } else {
+      foreach_(it, candidates) {
+        auto anime_item = AnimeDatabase.FindItem(*it);
+        if (!anime_item || (in_list && !anime_item->IsInList()))
+          continue;
+        if (CompareEpisode(episode, *anime_item, context, strict,
+                           check_episode, check_date, false))
+          return AnimeDatabase.FindItem(episode.anime_id);
+      }
+    }
+
+    // Score similar titles in case we need them later on. Scoring is expensive,
+    // so we only score a limited number of items that have the most trigrams in
+    // common with the episode title.
+    if (give_score) {
+      std::vector<int> score_candidates;
+      size_t limit = Settings.GetInt(taiga::kRecognition_ScoreCandidateLimit);
+      FindScoreCandidates(episode, candidates, in_list, check_date,
+                          score_candidates, limit);
+      foreach_(it, score_candidates) {
+        auto anime_item = AnimeDatabase.FindItem(*it);
+        if (anime_item)
+          ScoreTitle(episode, *anime_item, context);
+      }
+    }
+
+    return nullptr;
+  }
 
   if (reverse) {
     foreach_r_(it, AnimeDatabase.items) {
       if (in_list && !it->second.IsInList())
         continue;
-      if (Meow.CompareEpisode(episode, it->second, strict, check_episode,
-                              check_date, give_score))
+      if (CompareEpisode(episode, it->second, context, strict, check_episode,
+                         check_date, give_score))
         return AnimeDatabase.FindItem(episode.anime_id);
     }
   } else {
     foreach_(it, AnimeDatabase.items) {
       if (in_list && !it->second.IsInList())
         continue;
-      if (Meow.CompareEpisode(episode, it->second, strict, check_episode,
-                              check_date, give_score))
+      if (CompareEpisode(episode, it->second, context, strict, check_episode,
+                         check_date, give_score))
         return AnimeDatabase.FindItem(episode.anime_id);
     }
   }
@@ -99,8 +360,317 @@ anime::Item* RecognitionEngine::MatchDatabase(anime::Episode& episode,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Cached recognition
+
+// Items that have not aired yet are skipped if check_date is set, so a title
+// that is not matched today might be matched tomorrow. The date is not a part
+// of the key, so such results are not cached.
+static bool IsCacheable(const ParseOptions& options,
+                        const RecognitionCacheItem& item) {
+  return !item.examined || !options.match_database || !options.check_date ||
+         item.episode.anime_id > anime::ID_UNKNOWN;
+}
+
+bool RecognitionEngine::RecognizeTitle(const std::wstring& title,
+                                       anime::Episode& episode,
+                                       const ParseOptions& options) {
+  const unsigned int flags = options.GetFlags();
+  const unsigned int generation = AnimeDatabase.GetGeneration();
+
+  auto cache_item = cache_.Find(title, flags, generation);
+  if (cache_item) {
+    episode = cache_item->episode;
+    if (cache_item->examined && options.match_database)
+      context_.scores = cache_item->scores;
+    return cache_item->examined;
+  }
+
+  RecognitionCacheItem item;
+  item.examined = ExamineTitle(title, episode,
+                               options.examine_inside, options.examine_outside,
+                               options.examine_number, options.check_extras,
+                               options.check_extension);
+  if (item.examined && options.match_database) {
+    MatchDatabase(episode, context_, options.in_list, options.reverse,
+                  options.strict, options.check_episode, options.check_date,
+                  options.give_score);
+    if (options.give_score)
+      item.scores = context_.scores;
+  }
+  item.episode = episode;
+
+  if (IsCacheable(options, item))
+    cache_.Insert(title, flags, generation, item);
+
+  return item.examined;
+}
+
+void RecognitionEngine::ClearCache() {
+  cache_.Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Aliases
+
+// The title is mapped to the item that it matched, rather than to a sequel that
+// the episode number was resolved to, so that other episodes of the same title
+// are resolved through the relations as before.
+void RecognitionEngine::AddAlias(const anime::Episode& episode) {
+  if (episode.clean_title.empty() ||
+      episode.title_anime_id <= anime::ID_UNKNOWN)
+    return;
+
+  int& anime_id = aliases_[GetTitleIndexKey(episode.clean_title)];
+  if (anime_id == episode.title_anime_id)
+    return;
+  anime_id = episode.title_anime_id;
+
+  // Cached results might not agree with the new alias
+  ClearCache();
+
+  // Confirmations are rare, so we can afford to save right away
+  SaveAliases();
+}
+
+int RecognitionEngine::FindAlias(const std::wstring& clean_title) const {
+  if (aliases_.empty() || clean_title.empty())
+    return anime::ID_UNKNOWN;
+
+  auto it = aliases_.find(GetTitleIndexKey(clean_title));
+  return it != aliases_.end() ? it->second : anime::ID_UNKNOWN;
+}
+
+bool RecognitionEngine::LoadAliases() {
+  aliases_.clear();
+  ClearCache();
+
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathUserAliases);
+  unsigned int options = pugi::parse_default & ~pugi::parse_eol;
+  xml_parse_result parse_result = document.load_file(path.c_str(), options);
+
+  if (parse_result.status != pugi::status_ok)
+    return false;
+
+  // Keys depend on CleanTitle and GetTitleIndexKey, and are discarded along
+  // with the clean title cache when either of them changes
+  xml_node meta_node = document.child(L"meta");
+  if (XmlReadStrValue(meta_node, L"version") != clean_title_cache_version)
+    return false;
+
+  xml_node aliases_node = document.child(L"aliases");
+  foreach_xmlnode_(node, aliases_node, L"alias") {
+    int anime_id = node.attribute(L"id").as_int();
+    std::wstring title = node.child_value();
+    if (anime_id > anime::ID_UNKNOWN && !title.empty())
+      aliases_[title] = anime_id;
+  }
+
+  return true;
+}
+
+bool RecognitionEngine::SaveAliases() const {
+  xml_document document;
+
+  xml_node meta_node = document.append_child(L"meta");
+  XmlWriteStrValue(meta_node, L"version", clean_title_cache_version);
+
+  // Sorted by title, so that the file is easier to read and edit
+  std::map<std::wstring, int> sorted_aliases(aliases_.begin(), aliases_.end());
+
+  xml_node aliases_node = document.append_child(L"aliases");
+  foreach_(it, sorted_aliases) {
+    xml_node alias_node = aliases_node.append_child(L"alias");
+    alias_node.append_attribute(L"id") = it->second;
+    alias_node.append_child(pugi::node_pcdata).set_value(it->first.c_str());
+  }
+
+  std::wstring path = taiga::GetPath(taiga::kPathUserAliases);
+  return XmlWriteDocumentToFile(document, path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Statistics
+
+void RecognitionEngine::ResetStats() {
+  stats_.Reset();
+}
+
+bool RecognitionEngine::SaveStats() const {
+  return stats_.Save(taiga::GetPath(taiga::kPathRecognitionStats));
+}
+
+const RecognitionStats& RecognitionEngine::stats() const {
+  return stats_;
+}
+
+const RecognitionCache& RecognitionEngine::cache() const {
+  return cache_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Batch processing
+
+class RecognitionWorker : public win::Thread {
+public:
+  RecognitionWorker(const std::vector<std::wstring>& titles,
+                    const std::vector<size_t>& indexes,
+                    std::vector<anime::Episode>& episodes,
+                    std::vector<char>& examined,
+                    volatile LONG& next_index,
+                    const ParseOptions& options)
+      : titles_(titles), indexes_(indexes), episodes_(episodes),
+        examined_(examined), next_index_(next_index), options_(options) {}
+
+  DWORD ThreadProc() {
+    // Each worker picks the next unprocessed title until none are left, so
+    // that slow titles do not hold up the rest of the batch.
+    while (true) {
+      size_t next = static_cast<size_t>(InterlockedIncrement(&next_index_) - 1);
+      if (next >= indexes_.size())
+        break;
+      size_t index = indexes_.at(next);
+      anime::Episode& episode = episodes_.at(index);
+      examined_.at(index) = Meow.ExamineTitle(
+          titles_.at(index), episode,
+          options_.examine_inside, options_.examine_outside,
+          options_.examine_number, options_.check_extras,
+          options_.check_extension);
+      if (examined_.at(index) && options_.match_database)
+        Meow.MatchDatabase(episode, context_, options_.in_list,
+                           options_.reverse, options_.strict,
+                           options_.check_episode, options_.check_date, false);
+    }
+    return 0;
+  }
+
+private:
+  const std::vector<std::wstring>& titles_;
+  const std::vector<size_t>& indexes_;
+  std::vector<anime::Episode>& episodes_;
+  std::vector<char>& examined_;
+  volatile LONG& next_index_;
+  const ParseOptions& options_;
+  ParseContext context_;
+};
+
+void RecognitionEngine::ExamineTitles(const std::vector<std::wstring>& titles,
+                                      std::vector<anime::Episode>& episodes,
+                                      bool check_extension,
+                                      bool match_database,
+                                      bool in_list) {
+  ParseOptions options;
+  options.check_extension = check_extension;
+  options.match_database = match_database;
+  options.in_list = in_list;
+
+  std::vector<char> examined;
+  ExamineTitles(titles, episodes, examined, options, true);
+}
+
+void RecognitionEngine::ExamineTitles(const std::vector<std::wstring>& titles,
+                                      std::vector<anime::Episode>& episodes,
+                                      std::vector<char>& examined,
+                                      const ParseOptions& options,
+                                      bool use_cache) {
+  episodes.clear();
+  episodes.resize(titles.size());
+  examined.assign(titles.size(), 0);
+  if (titles.empty())
+    return;
+
+  // Worker threads must not modify shared data, so the title index has to be
+  // up to date before they start
+  if (!title_index_valid_)
+    UpdateCleanTitles();
+
+  const unsigned int flags = options.GetFlags();
+  const unsigned int generation = AnimeDatabase.GetGeneration();
+
+  // Titles that were recognized before are taken from the cache, which is only
+  // accessed by the calling thread
+  std::vector<size_t> indexes;
+  for (size_t i = 0; i < titles.size(); i++) {
+    auto cache_item = use_cache ?
+        cache_.Find(titles.at(i), flags, generation) : nullptr;
+    if (cache_item) {
+      episodes.at(i) = cache_item->episode;
+      examined.at(i) = cache_item->examined;
+    } else {
+      indexes.push_back(i);
+    }
+  }
+  if (indexes.empty())
+    return;
+
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  size_t thread_count = static_cast<size_t>(system_info.dwNumberOfProcessors);
+  thread_count = min(thread_count, indexes.size());
+  thread_count = min(thread_count, static_cast<size_t>(MAXIMUM_WAIT_OBJECTS));
+
+  volatile LONG next_index = 0;
+  std::vector<RecognitionWorker*> workers;
+  std::vector<HANDLE> handles;
+
+  for (size_t i = 1; i < thread_count; i++) {
+    auto worker = new RecognitionWorker(titles, indexes, episodes, examined,
+                                        next_index, options);
+    if (!worker->CreateThread(nullptr, 0, 0)) {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+    handles.push_back(worker->GetThreadHandle());
+  }
+
+  // The calling thread takes part as well, which also means that the batch is
+  // processed even if no worker thread could be created
+  RecognitionWorker(titles, indexes, episodes, examined,
+                    next_index, options).ThreadProc();
+
+  if (!handles.empty())
+    WaitForMultipleObjects(static_cast<DWORD>(handles.size()), &handles.at(0),
+                           TRUE, INFINITE);
+
+  foreach_(it, workers)
+    delete *it;
+
+  if (!use_cache)
+    return;
+
+  foreach_(it, indexes) {
+    RecognitionCacheItem item;
+    item.examined = examined.at(*it) != 0;
+    item.episode = episodes.at(*it);
+    if (IsCacheable(options, item))
+      cache_.Insert(titles.at(*it), flags, generation, item);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RecognitionEngine::CompareEpisode(anime::Episode& episode,
+                                       const anime::Item& anime_item,
+                                       bool strict,
+                                       bool check_episode,
+                                       bool check_date,
+                                       bool give_score) {
+  // Make sure that clean titles are available, as CompareEpisode may be called
+  // without going through MatchDatabase
+  if (!title_index_valid_)
+    UpdateCleanTitles();
+
+  return CompareEpisode(episode, anime_item, context_, strict, check_episode,
+                        check_date, give_score);
+}
+
 bool RecognitionEngine::CompareEpisode(anime::Episode& episode,
                                        const anime::Item& anime_item,
+                                       ParseContext& context,
                                        bool strict,
                                        bool check_episode,
                                        bool check_date,
@@ -116,10 +686,9 @@ bool RecognitionEngine::CompareEpisode(anime::Episode& episode,
   bool found = false;
 
   // Compare with titles
-  if (clean_titles[anime_item.GetId()].empty())
-    UpdateCleanTitles(anime_item.GetId());
-  foreach_(it, clean_titles[anime_item.GetId()]) {
-    found = CompareTitle(*it, episode, anime_item, strict);
+  const CleanTitleRange anime_titles = GetCleanTitles(anime_item.GetId());
+  for (size_t i = 0; i < anime_titles.size(); i++) {
+    found = CompareTitle(anime_titles[i], episode, anime_item, strict);
     if (found)
       break;
   }
@@ -127,24 +696,32 @@ bool RecognitionEngine::CompareEpisode(anime::Episode& episode,
   if (!found) {
     // Score title in case we need it later on
     if (give_score)
-      ScoreTitle(episode, anime_item);
+      ScoreTitle(episode, anime_item, context);
     // Leave if not found
     return false;
   }
 
+  return MatchEpisodeNumber(episode, anime_item, check_episode);
+}
+
+// Sets the anime ID of an episode whose title is known to belong to the item,
+// if the episode number is valid for either the item or one of its sequels
+bool RecognitionEngine::MatchEpisodeNumber(anime::Episode& episode,
+                                           const anime::Item& anime_item,
+                                           bool check_episode) {
+  episode.title_anime_id = anime_item.GetId();
+
   // Validate episode number
   if (check_episode && anime_item.GetEpisodeCount() > 0) {
     int number = anime::GetEpisodeHigh(episode.number);
     if (number > anime_item.GetEpisodeCount()) {
       // Check sequels
-      auto sequel = &anime_item;
-      do {
-        number -= sequel->GetEpisodeCount();
-        sequel = AnimeDatabase.FindSequel(sequel->GetId());
-      } while (sequel && number > sequel->GetEpisodeCount());
-      if (sequel) {
-        episode.anime_id = sequel->GetId();
-        episode.number = ToWstr(number);
+      int sequel_id = anime::ID_UNKNOWN;
+      int sequel_number = 0;
+      if (AnimeRelations.FindSequelEpisode(anime_item.GetId(), number,
+                                           sequel_id, sequel_number)) {
+        episode.anime_id = sequel_id;
+        episode.number = ToWstr(sequel_number);
         return true;
       }
       // Episode number is out of range
@@ -160,13 +737,37 @@ bool RecognitionEngine::CompareEpisode(anime::Episode& episode,
   return true;
 }
 
-bool RecognitionEngine::CompareTitle(const std::wstring& anime_title,
+// Same as IsCharsEqual, for comparing clean titles without copying them
+static bool IsTitleCharsEqual(const wchar_t c1, const wchar_t c2) {
+  return tolower(c1) == tolower(c2);
+}
+
+static bool IsTitleEqual(const CleanTitleView& str1, const std::wstring& str2) {
+  if (str1.length != str2.length())
+    return false;
+
+  return std::equal(str1.data, str1.data + str1.length, str2.begin(),
+                    &IsTitleCharsEqual);
+}
+
+static bool IsTitleInStr(const CleanTitleView& str1, const std::wstring& str2) {
+  if (str1.empty() || str1.length < str2.length())
+    return false;
+  if (str2.empty())
+    return true;
+
+  const wchar_t* end = str1.data + str1.length;
+  return std::search(str1.data, end, str2.begin(), str2.end(),
+                     &IsTitleCharsEqual) != end;
+}
+
+bool RecognitionEngine::CompareTitle(const CleanTitleView& anime_title,
                                      anime::Episode& episode,
                                      const anime::Item& anime_item,
                                      bool strict) {
   // Compare with title + number
   if (strict && anime_item.GetEpisodeCount() == 1 && !episode.number.empty()) {
-    if (IsEqual(episode.clean_title + episode.number, anime_title)) {
+    if (IsTitleEqual(anime_title, episode.clean_title + episode.number)) {
       episode.title += episode.number;
       episode.number.clear();
       return true;
@@ -174,79 +775,300 @@ bool RecognitionEngine::CompareTitle(const std::wstring& anime_title,
   }
   // Compare with title
   if (strict) {
-    if (IsEqual(anime_title, episode.clean_title))
+    if (IsTitleEqual(anime_title, episode.clean_title))
       return true;
   } else {
-    if (InStr(anime_title, episode.clean_title, 0, true) > -1)
+    if (IsTitleInStr(anime_title, episode.clean_title))
       return true;
   }
 
   return false;
 }
 
-std::multimap<int, int, std::greater<int>> RecognitionEngine::GetScores() {
-  std::multimap<int, int, std::greater<int>> reverse_map;
+CleanTitleRange RecognitionEngine::GetCleanTitles(int anime_id) const {
+  return clean_titles_.Find(anime_id);
+}
+
+const CleanTitleStore& RecognitionEngine::clean_titles() const {
+  return clean_titles_;
+}
+
+std::vector<std::pair<int, int>> RecognitionEngine::GetScores() const {
+  std::vector<std::pair<int, int>> scores;
 
-  foreach_(it, scores) {
-    if (it->second == 0)
+  foreach_(it, context_.scores) {
+    if (it->first == 0)
       continue;
-    reverse_map.insert(std::pair<int, int>(it->second, it->first));
+    scores.push_back(*it);
   }
 
-  return reverse_map;
+  std::sort(scores.begin(), scores.end(), IsBetterScore);
+
+  return scores;
+}
+
+// Returns the number of characters that two strings have in common, regardless
+// of their order. Non-ASCII characters share a single bucket, which can only
+// make the result larger.
+static int CountCommonCharacters(const std::wstring& str1,
+                                 const CleanTitleView& str2) {
+  int counts[128] = {0};
+
+  foreach_(it, str1)
+    counts[*it < 128 ? *it : 0]++;
+
+  int common = 0;
+  for (const wchar_t* it = str2.data; it != str2.data + str2.length; ++it) {
+    int& count = counts[*it < 128 ? *it : 0];
+    if (count > 0) {
+      count--;
+      common++;
+    }
+  }
+
+  return common;
 }
 
 bool RecognitionEngine::ScoreTitle(const anime::Episode& episode,
-                                   const anime::Item& anime_item) {
+                                   const anime::Item& anime_item,
+                                   ParseContext& context) {
+  const CleanTitleRange anime_titles = GetCleanTitles(anime_item.GetId());
+  if (anime_titles.empty())
+    return false;
+
   const std::wstring& episode_title = episode.clean_title;
-  const std::wstring& anime_title = clean_titles[anime_item.GetId()].front();
+  const CleanTitleView anime_title = anime_titles[0];
 
   const int score_bonus_small = 1;
   const int score_bonus_big = 5;
   const int score_min = std::abs(static_cast<int>(episode_title.length()) -
-                                 static_cast<int>(anime_title.length()));
-  const int score_max = episode_title.length() + anime_title.length();
-
-  int score = score_max;
-
-  score -= LevenshteinDistance(episode_title, anime_title);
-
-  score += LongestCommonSubsequenceLength(episode_title, anime_title) * 2;
-  score += LongestCommonSubstringLength(episode_title, anime_title) * 4;
-
-  if (score <= score_min)
-    return false;
+                                 static_cast<int>(anime_title.length));
+  const int score_max = episode_title.length() + anime_title.length;
 
+  int score_bonus = 0;
   if (anime_item.IsInList()) {
-    score += score_bonus_big;
+    score_bonus += score_bonus_big;
     switch (anime_item.GetMyStatus()) {
       case anime::kWatching:
       case anime::kPlanToWatch:
-        score += score_bonus_small;
+        score_bonus += score_bonus_small;
         break;
     }
   }
   switch (anime_item.GetType()) {
     case anime::kTv:
-      score += score_bonus_small;
+      score_bonus += score_bonus_small;
       break;
   }
   if (!episode.year.empty()) {
     if (anime_item.GetDateStart().year == ToInt(episode.year)) {
-      score += score_bonus_big;
+      score_bonus += score_bonus_big;
     }
   }
 
-  if (score > score_min) {
-    scores[anime_item.GetId()] = score;
-    return true;
+  // Skip the expensive part if the title cannot beat the scores we already
+  // have. Given the common character count c of the two titles, the distance
+  // is at least (max length - c), and both common subsequence and substring
+  // lengths are at most c. Since c cannot exceed the shorter length, that is
+  // checked first.
+  const int score_threshold = context.GetScoreThreshold();
+  const int length_min = (score_max - score_min) / 2;
+  if (length_min * 8 + score_bonus < score_threshold ||
+      length_min * 8 <= score_min) {
+    RecognitionStats::Add(stats_.candidates_skipped);
+    return false;
   }
+  const int common = CountCommonCharacters(episode_title, anime_title);
+  const int score_bound = length_min + common * 7;
+  if (score_bound + score_bonus < score_threshold ||
+      score_bound <= score_min) {
+    RecognitionStats::Add(stats_.candidates_skipped);
+    return false;
+  }
+
+  RecognitionStopwatch stopwatch;
+  RecognitionStats::Add(stats_.candidates_scored);
+
+  // Only the titles that make it this far are copied
+  const std::wstring anime_title_str = anime_title.str();
+
+  int score = score_max;
+
+  score -= LevenshteinDistance(episode_title, anime_title_str);
+
+  score += LongestCommonSubsequenceLength(episode_title, anime_title_str) * 2;
+  score += LongestCommonSubstringLength(episode_title, anime_title_str) * 4;
+
+  stopwatch.Lap(stats_, kStageScore);
+
+  if (score <= score_min)
+    return false;
+
+  score += score_bonus;
+
+  if (score > score_min)
+    return context.AddScore(anime_item.GetId(), score);
 
   return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Title index
+
+void RecognitionEngine::AddToTitleIndex(int anime_id) {
+  const CleanTitleRange titles = clean_titles_.Find(anime_id);
+  if (titles.empty())
+    return;
+
+  std::vector<QWORD> trigrams;
+
+  for (size_t i = 0; i < titles.size(); i++) {
+    if (titles[i].empty())
+      continue;
+    std::wstring key = GetTitleIndexKey(titles[i].str());
+    title_index_[key].insert(anime_id);
+    GetTrigrams(key, trigrams);
+  }
+
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+  foreach_(trigram, trigrams)
+    trigram_index_[*trigram].push_back(anime_id);
+  trigram_counts_[anime_id] = static_cast<int>(trigrams.size());
+}
+
+void RecognitionEngine::RemoveFromTitleIndex(int anime_id) {
+  const CleanTitleRange titles = clean_titles_.Find(anime_id);
+  if (titles.empty())
+    return;
+
+  std::vector<QWORD> trigrams;
+
+  for (size_t i = 0; i < titles.size(); i++) {
+    if (titles[i].empty())
+      continue;
+    std::wstring key = GetTitleIndexKey(titles[i].str());
+    auto entry = title_index_.find(key);
+    if (entry != title_index_.end()) {
+      entry->second.erase(anime_id);
+      if (entry->second.empty())
+        title_index_.erase(entry);
+    }
+    GetTrigrams(key, trigrams);
+  }
+
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+  foreach_(trigram, trigrams) {
+    auto entry = trigram_index_.find(*trigram);
+    if (entry != trigram_index_.end()) {
+      auto& ids = entry->second;
+      ids.erase(std::remove(ids.begin(), ids.end(), anime_id), ids.end());
+      if (ids.empty())
+        trigram_index_.erase(entry);
+    }
+  }
+  trigram_counts_.erase(anime_id);
+}
+
+size_t RecognitionEngine::FindTitleCandidates(const anime::Episode& episode,
+                                              std::set<int>& candidates) const {
+  // Title
+  auto it = title_index_.find(GetTitleIndexKey(episode.clean_title));
+  if (it != title_index_.end())
+    candidates.insert(it->second.begin(), it->second.end());
+
+  // Title + number (see CompareTitle)
+  if (!episode.number.empty()) {
+    it = title_index_.find(
+        GetTitleIndexKey(episode.clean_title + episode.number));
+    if (it != title_index_.end())
+      candidates.insert(it->second.begin(), it->second.end());
+  }
+
+  return candidates.size();
+}
+
+// Items are filtered before they are ranked, so that the limit is not used up
+// by items that would be skipped anyway. Items are ranked by the ratio of
+// common trigrams to the trigrams of both titles (i.e. Dice coefficient), so
+// that items with long titles don't crowd out the ones with short titles.
+size_t RecognitionEngine::FindScoreCandidates(const anime::Episode& episode,
+                                              const std::set<int>& excluded,
+                                              bool in_list,
+                                              bool check_date,
+                                              std::vector<int>& candidates,
+                                              size_t limit) const {
+  std::vector<QWORD> trigrams;
+  GetTrigrams(GetTitleIndexKey(episode.clean_title), trigrams);
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+  // Count common trigrams for each item
+  std::unordered_map<int, int> counts;
+  foreach_(trigram, trigrams) {
+    auto entry = trigram_index_.find(*trigram);
+    if (entry != trigram_index_.end())
+      foreach_(id, entry->second)
+        counts[*id] += 1;
+  }
+
+  // Mapped as <similarity, anime_id>
+  std::vector<std::pair<double, int>> ranking;
+  ranking.reserve(counts.size());
+  foreach_(it, counts) {
+    if (excluded.count(it->first))
+      continue;
+    auto anime_item = AnimeDatabase.FindItem(it->first);
+    if (!anime_item || (in_list && !anime_item->IsInList()))
+      continue;
+    if (check_date && !anime::IsAiredYet(*anime_item))
+      continue;
+    auto count = trigram_counts_.find(it->first);
+    int item_count = count != trigram_counts_.end() ? count->second : 0;
+    double similarity = 2.0 * it->second /
+        static_cast<double>(trigrams.size() + item_count);
+    ranking.push_back(std::make_pair(similarity, it->first));
+  }
+
+  if (limit > 0 && ranking.size() > limit) {
+    std::partial_sort(ranking.begin(), ranking.begin() + limit, ranking.end(),
+                      std::greater<std::pair<double, int>>());
+    ranking.resize(limit);
+  }
+
+  foreach_(it, ranking)
+    candidates.push_back(it->second);
+
+  return candidates.size();
+}
+
+// Index keys are folded to lowercase, which is a superset of what IsEqual
+// considers to be equal. Candidates are verified by CompareEpisode anyway.
+std::wstring RecognitionEngine::GetTitleIndexKey(const std::wstring& title) const {
+  return ToLower_Copy(title);
+}
+
+// Appends the trigrams of a key, which is padded with a space character on
+// both sides. Clean titles cannot include spaces, so this is safe, and it lets
+// us index titles that are shorter than three characters.
+void RecognitionEngine::GetTrigrams(const std::wstring& key,
+                                    std::vector<QWORD>& trigrams) const {
+  if (key.empty())
+    return;
+
+  std::wstring padded = L" " + key + L" ";
+
+  for (size_t i = 0; i + 2 < padded.length(); i++) {
+    trigrams.push_back((static_cast<QWORD>(padded[i]) << 32) |
+                       (static_cast<QWORD>(padded[i + 1]) << 16) |
+                       static_cast<QWORD>(padded[i + 2]));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool RecognitionEngine::ExamineTitle(std::wstring title,
                                      anime::Episode& episode,
                                      bool examine_inside,
@@ -254,6 +1076,9 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
                                      bool examine_number,
                                      bool check_extras,
                                      bool check_extension) {
+  RecognitionStopwatch stopwatch;
+  RecognitionStats::Add(stats_.titles);
+
   // Clear previous data
   episode.Clear();
 
@@ -282,7 +1107,7 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
       extension.length() < title.length() &&
       extension.length() <= 5) {
     if (IsAlphanumeric(extension) &&
-        CheckFileExtension(extension, valid_extensions)) {
+        GetKeywordCategories(extension) & kKeywordExtension) {
       episode.format = ToUpper_Copy(extension);
       title.resize(title.length() - extension.length() - 1);
     } else {
@@ -315,6 +1140,8 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
   std::vector<Token> tokens;
   tokens.reserve(4);
   TokenizeTitle(title, L"[](){}", tokens);
+  RecognitionStats::Add(stats_.tokens, tokens.size());
+  stopwatch.Lap(stats_, kStageTokenize);
   if (tokens.empty())
     return false;
   title.clear();
@@ -329,6 +1156,7 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
         ExamineToken(*token, episode, check_extras);
     }
   }
+  stopwatch.Lap(stats_, kStageKeyword);
 
   // Tidy up tokens
   for (size_t i = 1; i < tokens.size() - 1; i++) {
@@ -419,9 +1247,9 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
     ReplaceChar(tokens[title_index].content, tokens[title_index].separator, ' ');
     // Do some clean-up
     Trim(tokens[title_index].content, L" -");
-    // Set the title
-    title = tokens[title_index].content;
-    tokens[title_index].content.clear();
+    // Set the title, leaving the token empty
+    title.clear();
+    title.swap(tokens[title_index].content);
     tokens[title_index].untouched = false;
   }
 
@@ -526,7 +1354,8 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
       for (int i = 0; i < static_cast<int>(words.size()); i++) {
         if (number_index == -1 || i < number_index) {
           // Ignore episode keywords
-          if (i == number_index - 1 && CompareKeys(words[i], episode_keywords))
+          if (i == number_index - 1 &&
+              GetKeywordCategories(words[i]) & kKeywordEpisode)
             continue;
           AppendKeyword(title, words[i]);
         } else if (i > number_index) {
@@ -565,10 +1394,13 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
     }
   }
 
+  stopwatch.Lap(stats_, kStageNumber);
+
   // Examine remaining tokens once more
   foreach_(token, tokens)
     if (!token->content.empty())
       ExamineToken(*token, episode, true);
+  stopwatch.Lap(stats_, kStageKeyword);
 
   //////////////////////////////////////////////////////////////////////////////
 
@@ -576,6 +1408,7 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
   episode.title = title;
   episode.clean_title = title;
   CleanTitle(episode.clean_title);
+  stopwatch.Lap(stats_, kStageClean);
 
   return !title.empty();
 }
@@ -585,63 +1418,97 @@ bool RecognitionEngine::ExamineTitle(std::wstring title,
 void RecognitionEngine::ExamineToken(Token& token, anime::Episode& episode,
                                      bool compare_extras) {
   // Split into words. The most common non-alphanumeric character is the
-  // separator.
-  std::vector<std::wstring> words;
+  // separator. Words are visited as ranges of the token content, and copied
+  // into a single buffer, so that we don't allocate a string for each word.
   token.separator = GetMostCommonCharacter(token.content);
-  Split(token.content, std::wstring(1, token.separator), words);
+  const std::wstring& content = token.content;
+  const wchar_t separator = token.separator;
 
   // Revert if there are words that are too short. This prevents splitting some
   // group names (e.g. "m.3.3.w") and keywords (e.g. "H.264").
+  bool split = true;
   if (IsTokenEnclosed(token)) {
-    foreach_(word, words) {
-      if (word->length() == 1) {
-        words.clear();
-        words.push_back(token.content);
+    size_t index_begin = 0;
+    do {
+      size_t index_end = content.find(separator, index_begin);
+      if (index_end == std::wstring::npos)
+        index_end = content.length();
+      if (index_end - index_begin == 1) {
+        split = false;
         break;
       }
-    }
+      index_begin = index_end + 1;
+    } while (index_begin <= content.length());
   }
 
+  // Words are erased from the token content after all of them are examined,
+  // as the ranges would be invalidated otherwise. Mapped as
+  // <word, case insensitive>
+  std::vector<std::pair<std::wstring, bool>> erased_words;
+  std::wstring word;
+  word.reserve(content.length());
+
   // Compare with keywords
-  foreach_(word, words) {
-    Trim(*word);
-    if (word->empty())
+  size_t index_begin = 0;
+  do {
+    size_t index_end = split ? content.find(separator, index_begin) :
+                               std::wstring::npos;
+    if (index_end == std::wstring::npos)
+      index_end = content.length();
+    size_t word_begin = index_begin;
+    size_t word_end = index_end;
+    index_begin = index_end + 1;
+
+    // Trim
+    while (word_begin < word_end && content.at(word_begin) == ' ')
+      word_begin++;
+    while (word_end > word_begin && content.at(word_end - 1) == ' ')
+      word_end--;
+    if (word_begin == word_end)
       continue;
+    word.assign(content, word_begin, word_end - word_begin);
+    const unsigned int categories = GetKeywordCategories(word);
+    if (categories)
+      RecognitionStats::Add(stats_.keyword_hits);
+
     #define RemoveWordFromToken(b) { \
-      Erase(token.content, *word, b); token.untouched = false; }
+      erased_words.push_back(std::make_pair(word, b)); token.untouched = false; }
 
     // Checksum
-    if (episode.checksum.empty() && word->length() == 8 && IsHex(*word)) {
-      episode.checksum = *word;
+    if (episode.checksum.empty() && word.length() == 8 && IsHex(word)) {
+      episode.checksum = word;
       RemoveWordFromToken(false);
     // Video resolution
-    } else if (episode.resolution.empty() && IsResolution(*word)) {
-      episode.resolution = *word;
+    } else if (episode.resolution.empty() && IsResolution(word)) {
+      episode.resolution = word;
       RemoveWordFromToken(false);
     // Video info
-    } else if (CompareKeys(*word, video_keywords)) {
-      AppendKeyword(episode.video_type, *word);
+    } else if (categories & kKeywordVideo) {
+      AppendKeyword(episode.video_type, word);
       RemoveWordFromToken(true);
     // Audio info
-    } else if (CompareKeys(*word, audio_keywords)) {
-      AppendKeyword(episode.audio_type, *word);
+    } else if (categories & kKeywordAudio) {
+      AppendKeyword(episode.audio_type, word);
       RemoveWordFromToken(true);
     // Version
-    } else if (episode.version.empty() && CompareKeys(*word, version_keywords)) {
-      episode.version.push_back(word->at(word->length() - 1));
+    } else if (episode.version.empty() && categories & kKeywordVersion) {
+      episode.version.push_back(word.at(word.length() - 1));
       RemoveWordFromToken(true);
     // Extras
-    } else if (compare_extras && CompareKeys(*word, extra_keywords)) {
-      AppendKeyword(episode.extras, *word);
+    } else if (compare_extras && categories & kKeywordExtra) {
+      AppendKeyword(episode.extras, word);
       RemoveWordFromToken(true);
-    } else if (compare_extras && CompareKeys(*word, extra_unsafe_keywords)) {
-      AppendKeyword(episode.extras, *word);
+    } else if (compare_extras && categories & kKeywordExtraUnsafe) {
+      AppendKeyword(episode.extras, word);
       if (IsTokenEnclosed(token))
         RemoveWordFromToken(true);
     }
 
     #undef RemoveWordFromToken
-  }
+  } while (index_begin <= content.length());
+
+  foreach_(it, erased_words)
+    Erase(token.content, it->first, it->second);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -653,14 +1520,38 @@ void RecognitionEngine::AppendKeyword(std::wstring& str,
   AppendString(str, keyword, L" ");
 }
 
-bool RecognitionEngine::CompareKeys(const std::wstring& str,
-                                    const std::vector<std::wstring>& keys) {
-  if (!str.empty())
-    foreach_(key, keys)
-      if (IsEqual(str, *key))
-        return true;
+size_t RecognitionEngine::KeywordHash::operator()(
+    const std::wstring& str) const {
+  // FNV-1a, with ASCII characters folded to uppercase
+  size_t hash = 2166136261U;
+  foreach_(it, str) {
+    wchar_t c = *it;
+    if (c >= 'a' && c <= 'z')
+      c -= 'a' - 'A';
+    hash ^= static_cast<size_t>(c);
+    hash *= 16777619U;
+  }
+  return hash;
+}
 
-  return false;
+bool RecognitionEngine::KeywordEqual::operator()(
+    const std::wstring& str1, const std::wstring& str2) const {
+  return IsEqual(str1, str2);
+}
+
+void RecognitionEngine::AddKeywords(const std::vector<std::wstring>& keywords,
+                                    unsigned int category) {
+  foreach_(it, keywords)
+    keywords_[*it] |= category;
+}
+
+unsigned int RecognitionEngine::GetKeywordCategories(
+    const std::wstring& str) const {
+  if (str.empty())
+    return 0;
+
+  auto it = keywords_.find(str);
+  return it != keywords_.end() ? it->second : 0;
 }
 
 void RecognitionEngine::CleanTitle(std::wstring& title) {
@@ -668,39 +1559,178 @@ void RecognitionEngine::CleanTitle(std::wstring& title) {
     return;
 
   EraseUnnecessary(title);
-  TransliterateSpecial(title);
-  ErasePunctuation(title, true);
+  FoldTitle(title);
+}
+
+void RecognitionEngine::InvalidateCleanTitles() {
+  title_index_valid_ = false;
+  cache_.Clear();
+}
+
+void RecognitionEngine::UpdateCleanTitles() {
+  cache_.Clear();
+  clean_titles_.Clear();
+  clean_titles_.Reserve(AnimeDatabase.items.size(),
+                        AnimeDatabase.items.size() * 64);
+  title_index_.clear();
+  trigram_index_.clear();
+  trigram_counts_.clear();
+
+  // Must be set before updating items, or they would be skipped
+  title_index_valid_ = true;
+
+  foreach_(it, AnimeDatabase.items)
+    UpdateCleanTitles(it->first);
+
+  // Remaining items are no longer in the database
+  if (!clean_title_cache_.empty()) {
+    clean_title_cache_.clear();
+    clean_title_cache_modified_ = true;
+  }
 }
 
 void RecognitionEngine::UpdateCleanTitles(int anime_id) {
+  // Every item will be updated when the index is rebuilt
+  if (!title_index_valid_)
+    return;
+
+  cache_.Clear();
+
   auto anime_item = AnimeDatabase.FindItem(anime_id);
 
-  clean_titles[anime_id].clear();
+  RemoveFromTitleIndex(anime_id);
+
+  if (!anime_item) {
+    if (clean_titles_.Erase(anime_id))
+      clean_title_cache_modified_ = true;
+    return;
+  }
+
+  std::vector<std::wstring> titles;
+  GetSourceTitles(*anime_item, titles);
+
+  // Use the cached titles if they were cleaned from the same source titles
+  auto cache_item = clean_title_cache_.find(anime_id);
+  if (cache_item != clean_title_cache_.end() &&
+      cache_item->second.modified == anime_item->GetLastModified() &&
+      cache_item->second.hash == GetSourceTitleHash(titles) &&
+      cache_item->second.titles.size() == titles.size()) {
+    titles.swap(cache_item->second.titles);
+  } else {
+    foreach_(it, titles)
+      CleanTitle(*it);
+    clean_title_cache_modified_ = true;
+  }
+  if (cache_item != clean_title_cache_.end())
+    clean_title_cache_.erase(cache_item);
+
+  clean_titles_.Set(anime_id, titles);
+
+  AddToTitleIndex(anime_id);
+}
+
+void RecognitionEngine::GetSourceTitles(const anime::Item& anime_item,
+                                        std::vector<std::wstring>& titles) const {
+  titles.clear();
 
   // Main title
-  clean_titles[anime_id].push_back(anime_item->GetTitle());
-  CleanTitle(clean_titles[anime_id].back());
+  titles.push_back(anime_item.GetTitle());
 
   // English title
-  if (!anime_item->GetEnglishTitle().empty()) {
-    clean_titles[anime_id].push_back(anime_item->GetEnglishTitle());
-    CleanTitle(clean_titles[anime_id].back());
-  }
+  if (!anime_item.GetEnglishTitle().empty())
+    titles.push_back(anime_item.GetEnglishTitle());
 
   // Synonyms
-  if (!anime_item->GetUserSynonyms().empty()) {
-    foreach_(it, anime_item->GetUserSynonyms()) {
-      clean_titles[anime_id].push_back(*it);
-      CleanTitle(clean_titles[anime_id].back());
-    }
+  if (!anime_item.GetUserSynonyms().empty()) {
+    foreach_(it, anime_item.GetUserSynonyms())
+      titles.push_back(*it);
+  }
+  if (!anime_item.GetSynonyms().empty()) {
+    foreach_(it, anime_item.GetSynonyms())
+      titles.push_back(*it);
   }
-  if (!anime_item->GetSynonyms().empty()) {
-    auto synonyms = anime_item->GetSynonyms();
-    foreach_(it, synonyms) {
-      clean_titles[anime_id].push_back(*it);
-      CleanTitle(clean_titles[anime_id].back());
+}
+
+QWORD RecognitionEngine::GetSourceTitleHash(
+    const std::vector<std::wstring>& titles) const {
+  // FNV-1a, with a null character between titles
+  QWORD hash = 14695981039346656037ULL;
+  foreach_(title, titles) {
+    foreach_(it, *title) {
+      hash ^= static_cast<QWORD>(*it);
+      hash *= 1099511628211ULL;
     }
+    hash *= 1099511628211ULL;
   }
+  return hash;
+}
+
+bool RecognitionEngine::LoadCleanTitles() {
+  clean_title_cache_.clear();
+
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnimeTitles);
+  unsigned int options = pugi::parse_default & ~pugi::parse_eol;
+  xml_parse_result parse_result = document.load_file(path.c_str(), options);
+
+  if (parse_result.status != pugi::status_ok)
+    return false;
+
+  xml_node meta_node = document.child(L"meta");
+  if (XmlReadStrValue(meta_node, L"version") != clean_title_cache_version)
+    return false;
+
+  xml_node titles_node = document.child(L"titles");
+  foreach_xmlnode_(node, titles_node, L"anime") {
+    int anime_id = node.attribute(L"id").as_int();
+    auto& cache_item = clean_title_cache_[anime_id];
+    cache_item.modified = _wtoi64(node.attribute(L"modified").value());
+    cache_item.hash = _wcstoui64(node.attribute(L"hash").value(), nullptr, 10);
+    XmlReadChildNodes(node, cache_item.titles, L"title");
+  }
+
+  return true;
+}
+
+bool RecognitionEngine::SaveCleanTitles() {
+  // Clean titles might be outdated
+  if (!title_index_valid_)
+    return false;
+
+  if (!clean_title_cache_modified_)
+    return true;
+
+  xml_document document;
+
+  xml_node meta_node = document.append_child(L"meta");
+  XmlWriteStrValue(meta_node, L"version", clean_title_cache_version);
+
+  xml_node titles_node = document.append_child(L"titles");
+  std::vector<int> ids;
+  std::vector<std::wstring> source_titles;
+  std::vector<std::wstring> titles;
+  clean_titles_.GetIds(ids);
+  foreach_(it, ids) {
+    auto anime_item = AnimeDatabase.FindItem(*it);
+    if (!anime_item)
+      continue;
+    GetSourceTitles(*anime_item, source_titles);
+    clean_titles_.GetTitles(*it, titles);
+    xml_node anime_node = titles_node.append_child(L"anime");
+    anime_node.append_attribute(L"id") = *it;
+    anime_node.append_attribute(L"modified") =
+        ToWstr(static_cast<INT64>(anime_item->GetLastModified())).c_str();
+    anime_node.append_attribute(L"hash") =
+        ToWstr(static_cast<UINT64>(GetSourceTitleHash(source_titles))).c_str();
+    XmlWriteChildNodes(anime_node, titles, L"title", pugi::node_pcdata);
+  }
+
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnimeTitles);
+  if (!XmlWriteDocumentToFile(document, path))
+    return false;
+
+  clean_title_cache_modified_ = false;
+  return true;
 }
 
 void RecognitionEngine::EraseUnnecessary(std::wstring& str) {
@@ -711,116 +1741,121 @@ void RecognitionEngine::EraseUnnecessary(std::wstring& str) {
   Replace(str, L" specials", L" special", false, true);
 }
 
-// TODO: make faster
-void RecognitionEngine::TransliterateSpecial(std::wstring& str) {
-  // Character equivalencies
-  ReplaceChar(str, L'\u00E9', L'e');  // small e acute accent
-  ReplaceChar(str, L'\uFF0F', L'/');  // unicode slash
-  ReplaceChar(str, L'\uFF5E', L'~');  // unicode tilde
-  ReplaceChar(str, L'\u223C', L'~');  // unicode tilde 2
-  ReplaceChar(str, L'\u301C', L'~');  // unicode tilde 3
-  ReplaceChar(str, L'\uFF1F', L'?');  // unicode question mark
-  ReplaceChar(str, L'\uFF01', L'!');  // unicode exclamation point
-  ReplaceChar(str, L'\u00D7', L'x');  // multiplication symbol
-  ReplaceChar(str, L'\u2715', L'x');  // multiplication symbol 2
+// Transliterates special characters, applies common romanizations and erases
+// punctuation in a single pass. Trailing characters that are often a part of
+// titles are kept. Equivalent to the following, in order:
+//   ReplaceChar for each character in TitleFoldingTable
+//   Replace(str, L"\u014C", L"Ou");  // O macron
+//   Replace(str, L"\u014D", L"ou");  // o macron
+//   Replace(str, L"\u016B", L"uu");  // u macron
+//   Replace(str, L" wa ", L" ha ");  // hepburn to wapuro
+//   Replace(str, L" e ", L" he ");  // hepburn to wapuro
+//   Replace(str, L" o ", L" wo ");  // hepburn to wapuro
+//   Replace(str, L" & ", L" and ", true, false);  // abbreviation
+//   ErasePunctuation(str, true);
+void RecognitionEngine::FoldTitle(std::wstring& str) {
+  const TitleFoldingTable& table = title_folding_table;
+  const size_t length = str.length();
+
+  auto folded = [&](size_t i) -> wchar_t {
+    return i < length ? table.Fold(str[i]) : L'\0';
+  };
+
+  size_t trailing_begin = length;
+  while (trailing_begin > 0 && table.IsTrailing(folded(trailing_begin - 1)))
+    trailing_begin--;
+
+  std::wstring output;
+  output.reserve(length + 8);
+
+  // Replace does not rescan its own replacements, so these romanizations
+  // cannot match again on the space character that ended the previous match
+  size_t wa_begin = 0, e_begin = 0, o_begin = 0;
+  wchar_t pending = L'\0';
+
+  for (size_t i = 0; i < trailing_begin; i++) {
+    const wchar_t c = folded(i);
+
+    if (pending != L'\0') {
+      switch (pending) {
+        case L'w': output.push_back(L'h'); break;
+        case L'e': output.append(L"he"); break;
+        case L'o': output.append(L"wo"); break;
+        case L'&': output.append(L"and"); break;
+      }
+      pending = L'\0';
+      continue;
+    }
 
-  // A few common always-equivalent romanizations
-  Replace(str, L"\u014C", L"Ou");  // O macron
-  Replace(str, L"\u014D", L"ou");  // o macron
-  Replace(str, L"\u016B", L"uu");  // u macron
-  Replace(str, L" wa ", L" ha ");  // hepburn to wapuro
-  Replace(str, L" e ", L" he ");  // hepburn to wapuro
-  Replace(str, L" o ", L" wo ");  // hepburn to wapuro
+    switch (c) {
+      case L'\u014C': output.append(L"Ou"); continue;  // O macron
+      case L'\u014D': output.append(L"ou"); continue;  // o macron
+      case L'\u016B': output.append(L"uu"); continue;  // u macron
+      case L' ': {
+        const wchar_t next = folded(i + 1);
+        if (next == L'w' && i >= wa_begin &&
+            folded(i + 2) == L'a' && folded(i + 3) == L' ') {
+          pending = next;
+          wa_begin = i + 4;
+        } else if (next == L'e' && i >= e_begin && folded(i + 2) == L' ') {
+          pending = next;
+          e_begin = i + 3;
+        } else if (next == L'o' && i >= o_begin && folded(i + 2) == L' ') {
+          pending = next;
+          o_begin = i + 3;
+        } else if (next == L'&' && folded(i + 2) == L' ') {
+          pending = next;
+        }
+        continue;
+      }
+    }
 
-  // Abbreviations
-  Replace(str, L" & ", L" and ", true, false);
+    if (!table.IsPunctuation(c))
+      output.push_back(c);
+  }
+
+  for (size_t i = trailing_begin; i < length; i++)
+    output.push_back(folded(i));
+
+  str.swap(output);
 }
 
 bool RecognitionEngine::IsEpisodeFormat(const std::wstring& str,
                                         anime::Episode& episode,
                                         const wchar_t separator) {
-  unsigned int numstart, i, j;
-
-  // Find first number
-  for (numstart = 0; numstart < str.length() && !IsNumeric(str.at(numstart)); numstart++);
-  if (numstart == str.length())
-    return false;
+  EpisodePatternMatch match;
+  episode_patterns_.Match(str, separator, !episode.number.empty(), match);
 
-  // Check for episode prefix
-  if (numstart > 0)
-    if (!CompareKeys(str.substr(0, numstart), episode_prefixes))
+  switch (match.result) {
+    case kEpisodePatternInvalid:
+      episode.number.clear();
       return false;
 
-  for (i = numstart + 1; i < str.length(); i++) {
-    if (!IsNumeric(str.at(i))) {
-      // *#-#*
-      if (str.at(i) == '-' || str.at(i) == '&') {
-        if (i == str.length() - 1 || !IsNumeric(str.at(i + 1)))
-          return false;
-        for (j = i + 1; j < str.length() && IsNumeric(str.at(j)); j++);
-        episode.number = str.substr(numstart, j - numstart);
-        // *#-#*v#
-        if (j < str.length() - 1 && (str.at(j) == 'v' || str.at(j) =='V')) {
-          numstart = i + 1;
-          continue;
-        } else {
-          return true;
-        }
-
-      // v#
-      } else if (str.at(i) == 'v' || str.at(i) == 'V') {
-        if (episode.number.empty()) {
-          if (i == str.length() - 1 || !IsNumeric(str.at(i + 1))) return false;
-          episode.number = str.substr(numstart, i - numstart);
-        }
-        episode.version = str.substr(i + 1);
-        return true;
+    case kEpisodePatternNumber:
+      episode.number.assign(str, match.number_begin,
+                            match.number_end - match.number_begin);
+      if (match.version_begin != std::wstring::npos)
+        episode.version.assign(str, match.version_begin, std::wstring::npos);
+      return true;
 
-      // *# of #*
-      } else if (str.at(i) == separator) {
-        if (str.length() < i + 5)
-          return false;
-        if (str.at(i + 1) == 'o' &&
-            str.at(i + 2) == 'f' &&
-            str.at(i + 3) == separator) {
-          episode.number = str.substr(numstart, i - numstart);
-          return true;
-        }
+    case kEpisodePatternVersion:
+      episode.version.assign(str, match.version_begin, std::wstring::npos);
+      return true;
 
-      // *#x#*
-      } else if (str.at(i) == 'x') {
-        if (i == str.length() - 1 || !IsNumeric(str.at(i + 1)))
-          return false;
-        for (j = i + 1; j < str.length() && IsNumeric(str.at(j)); j++);
-        episode.number = str.substr(i + 1, j - i - 1);
-        if (ToInt(episode.number) < 100) {
-          return true;
-        } else {
-          episode.number.clear();
-          return false;
-        }
+    case kEpisodePatternPrefixedNumber:
+      episode.number.assign(str, match.number_begin,
+                            match.number_end - match.number_begin);
+      return ValidateEpisodeNumber(episode);
 
-      // Japanese counter
-      } else if (str.at(i) == L'\u8A71') {
-        episode.number = str.substr(numstart, i - 1);
+    case kEpisodePatternSeasonNumber:
+      episode.number.assign(str, match.number_begin,
+                            match.number_end - match.number_begin);
+      if (ToInt(episode.number) < 100)
         return true;
-
-      } else {
-        episode.number.clear();
-        return false;
-      }
-    }
-  }
-
-  // [prefix]#*
-  if (numstart > 0 && episode.number.empty()) {
-    episode.number = str.substr(numstart, str.length() - numstart);
-    if (!ValidateEpisodeNumber(episode))
+      episode.number.clear();
       return false;
-    return true;
   }
 
-  // *#
   return false;
 }
 
@@ -866,10 +1901,10 @@ size_t RecognitionEngine::TokenizeTitle(const std::wstring& str,
     size_t index_end = str.find_first_of(delimiters, index_begin + 1);
     tokens.resize(tokens.size() + 1);
     if (index_end == std::wstring::npos) {
-      tokens.back().content = str.substr(index_begin);
+      tokens.back().content.assign(str, index_begin, std::wstring::npos);
       break;
     } else {
-      tokens.back().content = str.substr(index_begin, index_end - index_begin);
+      tokens.back().content.assign(str, index_begin, index_end - index_begin);
       if (index_begin > 0)
         tokens.back().encloser = str.at(index_begin - 1);
       index_begin = str.find_first_not_of(delimiters, index_end + 1);
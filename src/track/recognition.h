@@ -19,10 +19,19 @@
 #ifndef TAIGA_TRACK_RECOGNITION_H
 #define TAIGA_TRACK_RECOGNITION_H
 
+#include <ctime>
 #include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <functional>
+
+#include "base/types.h"
+#include "track/recognition_cache.h"
+#include "track/recognition_pattern.h"
+#include "track/recognition_stats.h"
+#include "track/recognition_titles.h"
 
 namespace anime {
 class Episode;
@@ -30,6 +39,50 @@ class Item;
 }
 class Token;
 
+// Holds the state of a single recognition call. Each thread must use its own
+// context, so that titles can be matched concurrently.
+class ParseContext {
+public:
+  ParseContext();
+
+  void Reset();
+
+  // Keeps the score if it's among the best score_limit scores so far
+  bool AddScore(int anime_id, int score);
+  // Returns the lowest score that can still make it into the results, or
+  // INT_MIN if there is room for more
+  int GetScoreThreshold() const;
+
+  // Only the best scores are kept, as callers never need more than a few
+  size_t score_limit;
+
+  // Pairs of <score, anime_id>, kept as a heap with the worst score on top
+  std::vector<std::pair<int, int>> scores;
+};
+
+// Arguments of ExamineTitle and MatchDatabase, for functions that do both
+class ParseOptions {
+public:
+  ParseOptions();
+
+  // Used as a cache key
+  unsigned int GetFlags() const;
+
+  bool examine_inside;
+  bool examine_outside;
+  bool examine_number;
+  bool check_extras;
+  bool check_extension;
+
+  bool match_database;
+  bool in_list;
+  bool reverse;
+  bool strict;
+  bool check_episode;
+  bool check_date;
+  bool give_score;
+};
+
 class RecognitionEngine {
 public:
   RecognitionEngine();
@@ -44,6 +97,14 @@ public:
                              bool check_episode = true,
                              bool check_date = true,
                              bool give_score = false);
+  anime::Item* MatchDatabase(anime::Episode& episode,
+                             ParseContext& context,
+                             bool in_list = true,
+                             bool reverse = true,
+                             bool strict = true,
+                             bool check_episode = true,
+                             bool check_date = true,
+                             bool give_score = false);
 
   bool CompareEpisode(anime::Episode& episode,
                       const anime::Item& anime_item,
@@ -51,6 +112,36 @@ public:
                       bool check_episode = true,
                       bool check_date = true,
                       bool give_score = false);
+  bool CompareEpisode(anime::Episode& episode,
+                      const anime::Item& anime_item,
+                      ParseContext& context,
+                      bool strict = true,
+                      bool check_episode = true,
+                      bool check_date = true,
+                      bool give_score = false);
+
+  // Same as ExamineTitle followed by MatchDatabase, if options.match_database
+  // is set. Results are cached until the anime database is modified.
+  bool RecognizeTitle(const std::wstring& title,
+                      anime::Episode& episode,
+                      const ParseOptions& options);
+
+  // Examines and matches a batch of titles on a pool of worker threads, and
+  // blocks until all of them are processed. Must be called from the main
+  // thread, as the database must not be modified in the meantime.
+  void ExamineTitles(const std::vector<std::wstring>& titles,
+                     std::vector<anime::Episode>& episodes,
+                     bool check_extension = true,
+                     bool match_database = true,
+                     bool in_list = true);
+  // Same as above, with any options. Titles that could be examined are marked
+  // in examined. Titles that are seen only once (e.g. file names in a folder
+  // scan) are not worth caching, and are left out unless use_cache is set.
+  void ExamineTitles(const std::vector<std::wstring>& titles,
+                     std::vector<anime::Episode>& episodes,
+                     std::vector<char>& examined,
+                     const ParseOptions& options,
+                     bool use_cache);
 
   bool ExamineTitle(std::wstring title,
                     anime::Episode& episode,
@@ -63,14 +154,31 @@ public:
   void ExamineToken(Token& token, anime::Episode& episode, bool compare_extras);
 
   void CleanTitle(std::wstring& title);
+  void InvalidateCleanTitles();
+  void UpdateCleanTitles();
   void UpdateCleanTitles(int anime_id);
+  bool LoadCleanTitles();
+  bool SaveCleanTitles();
 
-  std::multimap<int, int, std::greater<int>> GetScores();
+  // Remembers the clean title of an episode that the user has confirmed, so
+  // that MatchDatabase can resolve it without comparing titles
+  void AddAlias(const anime::Episode& episode);
+  int FindAlias(const std::wstring& clean_title) const;
+  bool LoadAliases();
+  bool SaveAliases() const;
 
-  // Mapped as <anime_id, score>
-  std::map<int, int> scores;
+  void ClearCache();
+  const RecognitionCache& cache() const;
 
-  std::map<int, std::vector<std::wstring>> clean_titles;
+  void ResetStats();
+  bool SaveStats() const;
+  const RecognitionStats& stats() const;
+
+  CleanTitleRange GetCleanTitles(int anime_id) const;
+  const CleanTitleStore& clean_titles() const;
+
+  // Returns pairs of <score, anime_id>, sorted from best to worst
+  std::vector<std::pair<int, int>> GetScores() const;
 
   std::vector<std::wstring> audio_keywords;
   std::vector<std::wstring> video_keywords;
@@ -82,17 +190,70 @@ public:
   std::vector<std::wstring> episode_prefixes;
 
 private:
-  bool CompareTitle(const std::wstring& anime_title,
+  anime::Item* FindMatchingItem(anime::Episode& episode,
+                                ParseContext& context,
+                                bool in_list,
+                                bool reverse,
+                                bool strict,
+                                bool check_episode,
+                                bool check_date,
+                                bool give_score);
+  bool CompareTitle(const CleanTitleView& anime_title,
                     anime::Episode& episode,
                     const anime::Item& anime_item,
                     bool strict = true);
   bool ScoreTitle(const anime::Episode& episode,
-                  const anime::Item& anime_item);
+                  const anime::Item& anime_item,
+                  ParseContext& context);
+  bool MatchEpisodeNumber(anime::Episode& episode,
+                          const anime::Item& anime_item,
+                          bool check_episode);
+
+  class CleanTitleCacheItem {
+  public:
+    time_t modified;
+    QWORD hash;
+    std::vector<std::wstring> titles;
+  };
+
+  void GetSourceTitles(const anime::Item& anime_item, std::vector<std::wstring>& titles) const;
+  QWORD GetSourceTitleHash(const std::vector<std::wstring>& titles) const;
+
+  void AddToTitleIndex(int anime_id);
+  void RemoveFromTitleIndex(int anime_id);
+  size_t FindTitleCandidates(const anime::Episode& episode, std::set<int>& candidates) const;
+  size_t FindScoreCandidates(const anime::Episode& episode,
+                             const std::set<int>& excluded,
+                             bool in_list, bool check_date,
+                             std::vector<int>& candidates, size_t limit) const;
+  std::wstring GetTitleIndexKey(const std::wstring& title) const;
+  void GetTrigrams(const std::wstring& key, std::vector<QWORD>& trigrams) const;
+
+  enum KeywordCategory {
+    kKeywordAudio         = 1 << 0,
+    kKeywordVideo         = 1 << 1,
+    kKeywordExtra         = 1 << 2,
+    kKeywordExtraUnsafe   = 1 << 3,
+    kKeywordVersion       = 1 << 4,
+    kKeywordExtension     = 1 << 5,
+    kKeywordEpisode       = 1 << 6,
+    kKeywordEpisodePrefix = 1 << 7
+  };
+
+  // Keywords are compared case-insensitively, as in IsEqual
+  struct KeywordHash {
+    size_t operator()(const std::wstring& str) const;
+  };
+  struct KeywordEqual {
+    bool operator()(const std::wstring& str1, const std::wstring& str2) const;
+  };
+
+  void AddKeywords(const std::vector<std::wstring>& keywords, unsigned int category);
+  unsigned int GetKeywordCategories(const std::wstring& str) const;
 
   void AppendKeyword(std::wstring& str, const std::wstring& keyword);
-  bool CompareKeys(const std::wstring& str, const std::vector<std::wstring>& keys);
   void EraseUnnecessary(std::wstring& str);
-  void TransliterateSpecial(std::wstring& str);
+  void FoldTitle(std::wstring& str);
   bool IsEpisodeFormat(const std::wstring& str, anime::Episode& episode, const wchar_t separator = ' ');
   bool IsResolution(const std::wstring& str);
   bool IsCountingWord(const std::wstring& str);
@@ -100,6 +261,38 @@ private:
   void ReadKeyword(std::vector<std::wstring>& output, const std::wstring& input);
   size_t TokenizeTitle(const std::wstring& str, const std::wstring& delimiters, std::vector<Token>& tokens);
   bool ValidateEpisodeNumber(anime::Episode& episode);
+
+  // Only modified by the main thread, through UpdateCleanTitles()
+  CleanTitleStore clean_titles_;
+
+  // Mapped as <normalized clean title, anime IDs>
+  std::unordered_map<std::wstring, std::set<int>> title_index_;
+  // Mapped as <trigram of normalized clean titles, anime IDs>
+  std::unordered_map<QWORD, std::vector<int>> trigram_index_;
+  // Mapped as <anime ID, number of distinct trigrams in its titles>
+  std::unordered_map<int, int> trigram_counts_;
+  bool title_index_valid_;
+
+  // Mapped as <normalized clean title, anime ID>. Only modified by the main
+  // thread, through AddAlias() and LoadAliases().
+  std::unordered_map<std::wstring, int> aliases_;
+
+  // Mapped as <anime_id, clean titles>, as they were loaded from the disk.
+  // Items are removed as they are used.
+  std::map<int, CleanTitleCacheItem> clean_title_cache_;
+  bool clean_title_cache_modified_;
+
+  // Mapped as <keyword, categories>
+  std::unordered_map<std::wstring, unsigned int,
+                     KeywordHash, KeywordEqual> keywords_;
+
+  EpisodePatternMatcher episode_patterns_;
+
+  // Used by the main thread
+  ParseContext context_;
+  RecognitionCache cache_;
+
+  RecognitionStats stats_;
 };
 
 extern RecognitionEngine Meow;
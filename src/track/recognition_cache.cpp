@@ -0,0 +1,124 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "track/recognition_cache.h"
+
+RecognitionCache::RecognitionCache()
+    : capacity_(1000),
+      generation_(0),
+      hits_(0),
+      misses_(0) {
+}
+
+const RecognitionCacheItem* RecognitionCache::Find(const std::wstring& title,
+                                                   unsigned int flags,
+                                                   unsigned int generation) {
+  SetGeneration(generation);
+
+  auto it = index_.find(GetKey(title, flags));
+
+  if (it == index_.end()) {
+    misses_++;
+    return nullptr;
+  }
+
+  // Move to front
+  items_.splice(items_.begin(), items_, it->second);
+
+  hits_++;
+  return &it->second->second;
+}
+
+void RecognitionCache::Insert(const std::wstring& title,
+                              unsigned int flags,
+                              unsigned int generation,
+                              const RecognitionCacheItem& item) {
+  if (capacity_ == 0)
+    return;
+
+  SetGeneration(generation);
+
+  std::wstring key = GetKey(title, flags);
+
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->second = item;
+    items_.splice(items_.begin(), items_, it->second);
+    return;
+  }
+
+  // Discard the least recently used item
+  if (items_.size() >= capacity_) {
+    index_.erase(items_.back().first);
+    items_.pop_back();
+  }
+
+  items_.push_front(std::make_pair(key, item));
+  index_[key] = items_.begin();
+}
+
+void RecognitionCache::Clear() {
+  items_.clear();
+  index_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t RecognitionCache::capacity() const {
+  return capacity_;
+}
+
+size_t RecognitionCache::hits() const {
+  return hits_;
+}
+
+size_t RecognitionCache::misses() const {
+  return misses_;
+}
+
+size_t RecognitionCache::size() const {
+  return items_.size();
+}
+
+void RecognitionCache::set_capacity(size_t capacity) {
+  capacity_ = capacity;
+
+  while (items_.size() > capacity_) {
+    index_.erase(items_.back().first);
+    items_.pop_back();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Flags are stored in the first character of the key
+std::wstring RecognitionCache::GetKey(const std::wstring& title,
+                                      unsigned int flags) const {
+  std::wstring key;
+  key.reserve(title.length() + 1);
+  key.push_back(static_cast<wchar_t>(flags));
+  key.append(title);
+  return key;
+}
+
+void RecognitionCache::SetGeneration(unsigned int generation) {
+  if (generation != generation_) {
+    Clear();
+    generation_ = generation;
+  }
+}
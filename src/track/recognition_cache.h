@@ -0,0 +1,82 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TRACK_RECOGNITION_CACHE_H
+#define TAIGA_TRACK_RECOGNITION_CACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "library/anime_episode.h"
+
+class RecognitionCacheItem {
+public:
+  RecognitionCacheItem() : examined(false) {}
+
+  bool examined;
+  anime::Episode episode;
+  // Pairs of <score, anime_id>, as in ParseContext
+  std::vector<std::pair<int, int>> scores;
+};
+
+// Keeps the results of recent recognitions, so that titles that are seen over
+// and over again (e.g. media player titles, feed items, file names) are not
+// parsed each time. Items are discarded when the generation changes, which
+// happens whenever the anime database is modified. Results that depend on the
+// current date are not inserted by RecognitionEngine.
+class RecognitionCache {
+public:
+  RecognitionCache();
+  ~RecognitionCache() {}
+
+  const RecognitionCacheItem* Find(const std::wstring& title,
+                                   unsigned int flags,
+                                   unsigned int generation);
+  void Insert(const std::wstring& title,
+              unsigned int flags,
+              unsigned int generation,
+              const RecognitionCacheItem& item);
+  void Clear();
+
+  size_t capacity() const;
+  size_t hits() const;
+  size_t misses() const;
+  size_t size() const;
+
+  void set_capacity(size_t capacity);
+
+private:
+  std::wstring GetKey(const std::wstring& title, unsigned int flags) const;
+  void SetGeneration(unsigned int generation);
+
+  typedef std::pair<std::wstring, RecognitionCacheItem> value_t;
+
+  // Most recently used items come first
+  std::list<value_t> items_;
+  std::unordered_map<std::wstring, std::list<value_t>::iterator> index_;
+
+  size_t capacity_;
+  unsigned int generation_;
+  size_t hits_;
+  size_t misses_;
+};
+
+#endif  // TAIGA_TRACK_RECOGNITION_CACHE_H
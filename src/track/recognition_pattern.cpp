@@ -0,0 +1,396 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <windows.h>
+#include <cctype>
+
+#include "base/foreach.h"
+#include "track/recognition_pattern.h"
+
+// Character classes. Classes for the characters of episode prefixes are added
+// after these, as the prefixes are compiled.
+enum EpisodePatternClass {
+  kClassOther,
+  kClassDigit,
+  kClassRange,      // - &
+  kClassVersion,    // v V
+  kClassSeparator,  // Depends on the token
+  kClassCross,      // x
+  kClassOfO,        // o
+  kClassOfF,        // f
+  kClassCounter,    // Japanese counter for episodes
+  kClassSeasonS,    // s S
+  kClassSeasonE,    // e E
+  kClassCount,
+  kClassAny = kClassCount
+};
+
+// Fixed states. States for episode prefixes are added after these.
+enum EpisodePatternState {
+  kStateReject,
+  kStateStart,
+  kStateNumber,
+  kStateSeparator,
+  kStateOf,
+  kStateOfF,
+  kStateRange,
+  kStateRangeNumber,
+  kStateRangeVersion,
+  kStateVersion,
+  kStateCross,
+  kStateCrossNumber,
+  kStateSeason,
+  kStateSeasonNumber,
+  kStateSeasonE,
+  kStateSeasonEpisode,
+  kStateCount
+};
+
+enum EpisodePatternAction {
+  kActionNone,
+  kActionReject,
+  kActionInvalid,
+  kActionBeginNumber,
+  kActionBeginPrefixedNumber,
+  kActionEndNumber,
+  kActionVersion,
+  kActionSeparator,
+  kActionAccept,
+  kActionAcceptHere,
+  kActionAcceptVersion,
+  kActionAcceptPrefixed,
+  kActionAcceptCross
+};
+
+class EpisodePatternRule {
+public:
+  int state;
+  int input;
+  int next;
+  int action;
+};
+
+// Each line moves the automaton from one state to another on a class of
+// characters. kClassAny covers all the classes that are not listed for that
+// state, including the ones that are added for prefixes. Patterns are tried
+// from left to right, and the first one to make a decision wins.
+static const EpisodePatternRule episode_pattern_rules[] = {
+  // #
+  {kStateStart,         kClassDigit,     kStateNumber,        kActionBeginNumber},
+  {kStateNumber,        kClassDigit,     kStateNumber,        kActionNone},
+  {kStateNumber,        kClassAny,       kStateReject,        kActionInvalid},
+  // #-#*, #&#*, #-#v*
+  {kStateNumber,        kClassRange,     kStateRange,         kActionNone},
+  {kStateRange,         kClassDigit,     kStateRangeNumber,   kActionNone},
+  {kStateRangeNumber,   kClassDigit,     kStateRangeNumber,   kActionNone},
+  {kStateRangeNumber,   kClassVersion,   kStateRangeVersion,  kActionEndNumber},
+  {kStateRangeNumber,   kClassAny,       kStateReject,        kActionAcceptHere},
+  {kStateRangeVersion,  kClassAny,       kStateReject,        kActionAcceptVersion},
+  // #v#*
+  {kStateNumber,        kClassVersion,   kStateVersion,       kActionVersion},
+  {kStateVersion,       kClassDigit,     kStateReject,        kActionAcceptVersion},
+  // # of #*
+  {kStateNumber,        kClassSeparator, kStateSeparator,     kActionSeparator},
+  {kStateSeparator,     kClassDigit,     kStateNumber,        kActionNone},
+  {kStateSeparator,     kClassRange,     kStateRange,         kActionNone},
+  {kStateSeparator,     kClassVersion,   kStateVersion,       kActionVersion},
+  {kStateSeparator,     kClassSeparator, kStateSeparator,     kActionSeparator},
+  {kStateSeparator,     kClassCross,     kStateCross,         kActionNone},
+  {kStateSeparator,     kClassCounter,   kStateReject,        kActionAcceptHere},
+  {kStateSeparator,     kClassOfO,       kStateOf,            kActionNone},
+  {kStateSeparator,     kClassAny,       kStateReject,        kActionInvalid},
+  {kStateOf,            kClassOfF,       kStateOfF,           kActionNone},
+  {kStateOf,            kClassAny,       kStateReject,        kActionInvalid},
+  {kStateOfF,           kClassSeparator, kStateReject,        kActionAccept},
+  {kStateOfF,           kClassAny,       kStateReject,        kActionInvalid},
+  // #x#*
+  {kStateNumber,        kClassCross,     kStateCross,         kActionNone},
+  {kStateCross,         kClassDigit,     kStateCrossNumber,   kActionBeginNumber},
+  {kStateCrossNumber,   kClassDigit,     kStateCrossNumber,   kActionNone},
+  {kStateCrossNumber,   kClassAny,       kStateReject,        kActionAcceptCross},
+  // #<counter>
+  {kStateNumber,        kClassCounter,   kStateReject,        kActionAcceptHere},
+  // S#E#, S#E#v#*
+  {kStateStart,         kClassSeasonS,   kStateSeason,        kActionNone},
+  {kStateSeason,        kClassDigit,     kStateSeasonNumber,  kActionNone},
+  {kStateSeasonNumber,  kClassDigit,     kStateSeasonNumber,  kActionNone},
+  {kStateSeasonNumber,  kClassSeasonE,   kStateSeasonE,       kActionNone},
+  {kStateSeasonE,       kClassDigit,     kStateSeasonEpisode, kActionBeginNumber},
+  {kStateSeasonEpisode, kClassDigit,     kStateSeasonEpisode, kActionNone},
+  {kStateSeasonEpisode, kClassVersion,   kStateVersion,       kActionVersion}
+};
+
+// Actions that are taken if the input ends in a state
+static const EpisodePatternRule episode_pattern_final_rules[] = {
+  {kStateNumber,        kClassAny, kStateReject, kActionAcceptPrefixed},
+  {kStateSeparator,     kClassAny, kStateReject, kActionAcceptPrefixed},
+  {kStateRangeNumber,   kClassAny, kStateReject, kActionAcceptHere},
+  {kStateRangeVersion,  kClassAny, kStateReject, kActionAccept},
+  {kStateCrossNumber,   kClassAny, kStateReject, kActionAcceptCross},
+  {kStateSeasonEpisode, kClassAny, kStateReject, kActionAcceptHere}
+};
+
+// States in which the separator of the token has a meaning of its own
+static const int episode_pattern_separator_states[] = {
+  kStateNumber, kStateSeparator, kStateOfF
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+EpisodePatternMatch::EpisodePatternMatch()
+    : result(kEpisodePatternNone),
+      number_begin(0),
+      number_end(0),
+      version_begin(std::wstring::npos) {
+}
+
+EpisodePatternMatcher::EpisodePatternMatcher()
+    : class_count_(0),
+      state_count_(0) {
+  Compile(std::vector<std::wstring>());
+}
+
+void EpisodePatternMatcher::Compile(const std::vector<std::wstring>& prefixes) {
+  // Character classes
+  for (int i = 0; i < 128; i++)
+    ascii_classes_[i] = kClassOther;
+  for (wchar_t c = '0'; c <= '9'; c++)
+    ascii_classes_[c] = kClassDigit;
+  ascii_classes_['-'] = kClassRange;
+  ascii_classes_['&'] = kClassRange;
+  ascii_classes_['v'] = kClassVersion;
+  ascii_classes_['V'] = kClassVersion;
+  ascii_classes_['x'] = kClassCross;
+  ascii_classes_['o'] = kClassOfO;
+  ascii_classes_['f'] = kClassOfF;
+  ascii_classes_['s'] = kClassSeasonS;
+  ascii_classes_['S'] = kClassSeasonS;
+  ascii_classes_['e'] = kClassSeasonE;
+  ascii_classes_['E'] = kClassSeasonE;
+  other_classes_.clear();
+  other_classes_[L'\u8A71'] = kClassCounter;
+  class_count_ = kClassCount;
+
+  foreach_(prefix, prefixes) {
+    foreach_(it, *prefix) {
+      AddClass(*it);
+      if (*it < 128) {
+        AddClass(static_cast<wchar_t>(tolower(*it)));
+        AddClass(static_cast<wchar_t>(toupper(*it)));
+      }
+    }
+  }
+
+  // States
+  transitions_.clear();
+  final_actions_.clear();
+  separator_states_.clear();
+  state_count_ = 0;
+  while (state_count_ < kStateCount)
+    AddState();
+
+  for (size_t i = 0; i < ARRAYSIZE(episode_pattern_rules); i++) {
+    const EpisodePatternRule& rule = episode_pattern_rules[i];
+    if (rule.input != kClassAny)
+      continue;
+    for (int input = 0; input < class_count_; input++) {
+      Transition& transition = GetTransition(rule.state, input);
+      transition.next = rule.next;
+      transition.action = rule.action;
+    }
+  }
+  for (size_t i = 0; i < ARRAYSIZE(episode_pattern_rules); i++) {
+    const EpisodePatternRule& rule = episode_pattern_rules[i];
+    if (rule.input == kClassAny)
+      continue;
+    Transition& transition = GetTransition(rule.state, rule.input);
+    transition.next = rule.next;
+    transition.action = rule.action;
+  }
+  for (size_t i = 0; i < ARRAYSIZE(episode_pattern_final_rules); i++) {
+    const EpisodePatternRule& rule = episode_pattern_final_rules[i];
+    final_actions_.at(rule.state) = rule.action;
+  }
+  for (size_t i = 0; i < ARRAYSIZE(episode_pattern_separator_states); i++)
+    separator_states_.at(episode_pattern_separator_states[i]) = true;
+
+  // Episode prefixes form a tree that starts from the initial state, and
+  // continues to the number state on a digit. Prefixes are compared
+  // case-insensitively. A prefix that would take the place of another
+  // pattern is ignored.
+  foreach_(prefix, prefixes) {
+    if (prefix->empty())
+      continue;
+    int state = kStateStart;
+    foreach_(it, *prefix) {
+      wchar_t variants[] = {*it, *it, *it};
+      if (*it < 128) {
+        variants[1] = static_cast<wchar_t>(tolower(*it));
+        variants[2] = static_cast<wchar_t>(toupper(*it));
+      }
+      int next = kStateReject;
+      for (size_t i = 0; i < ARRAYSIZE(variants); i++) {
+        int input = GetClass(variants[i]);
+        int current = GetTransition(state, input).next;
+        if (current == kStateReject) {
+          if (next == kStateReject)
+            next = AddState();
+          GetTransition(state, input).next = next;
+          GetTransition(state, input).action = kActionNone;
+        } else if (current >= kStateCount) {
+          next = current;
+        }
+      }
+      state = next;
+      if (state == kStateReject)
+        break;
+    }
+    if (state != kStateReject) {
+      Transition& transition = GetTransition(state, kClassDigit);
+      transition.next = kStateNumber;
+      transition.action = kActionBeginPrefixedNumber;
+    }
+  }
+}
+
+void EpisodePatternMatcher::Match(const std::wstring& str,
+                                  wchar_t separator,
+                                  bool has_number,
+                                  EpisodePatternMatch& match) const {
+  match = EpisodePatternMatch();
+
+  const size_t length = str.length();
+  bool prefixed = false;
+  int state = kStateStart;
+  int action = kActionNone;
+  size_t i = 0;
+
+  for ( ; i < length; i++) {
+    const wchar_t c = str[i];
+    int input = GetClass(c);
+    if (c == separator && separator_states_[state] &&
+        input != kClassDigit && input != kClassRange && input != kClassVersion)
+      input = kClassSeparator;
+
+    const Transition& transition = GetTransition(state, input);
+    state = transition.next;
+    action = transition.action;
+
+    switch (action) {
+      case kActionNone:
+        continue;
+      case kActionBeginNumber:
+        match.number_begin = i;
+        continue;
+      case kActionBeginPrefixedNumber:
+        match.number_begin = i;
+        prefixed = true;
+        continue;
+      case kActionEndNumber:
+        match.number_end = i;
+        continue;
+      case kActionVersion:
+        match.number_end = i;
+        if (has_number) {
+          match.result = kEpisodePatternVersion;
+          match.version_begin = i + 1;
+          return;
+        }
+        continue;
+      case kActionSeparator:
+        // "of" must be followed by at least one character
+        if (i + 5 > length)
+          return;
+        match.number_end = i;
+        continue;
+    }
+    break;
+  }
+
+  if (i == length)
+    action = final_actions_[state];
+
+  switch (action) {
+    case kActionInvalid:
+      match.result = kEpisodePatternInvalid;
+      break;
+    case kActionAccept:
+      match.result = kEpisodePatternNumber;
+      break;
+    case kActionAcceptHere:
+      match.result = kEpisodePatternNumber;
+      match.number_end = i;
+      break;
+    case kActionAcceptVersion:
+      match.result = kEpisodePatternNumber;
+      match.version_begin = i;
+      break;
+    case kActionAcceptPrefixed:
+      if (prefixed && !has_number) {
+        match.result = kEpisodePatternPrefixedNumber;
+        match.number_end = i;
+      }
+      break;
+    case kActionAcceptCross:
+      match.result = kEpisodePatternSeasonNumber;
+      match.number_end = i;
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int EpisodePatternMatcher::AddClass(wchar_t c) {
+  int input = GetClass(c);
+  if (input != kClassOther)
+    return input;
+
+  input = class_count_++;
+  if (c < 128) {
+    ascii_classes_[c] = static_cast<unsigned char>(input);
+  } else {
+    other_classes_[c] = input;
+  }
+  return input;
+}
+
+int EpisodePatternMatcher::AddState() {
+  Transition transition = {kStateReject, kActionReject};
+  transitions_.resize(transitions_.size() + class_count_, transition);
+  final_actions_.push_back(kActionReject);
+  separator_states_.push_back(false);
+  return state_count_++;
+}
+
+int EpisodePatternMatcher::GetClass(wchar_t c) const {
+  if (c < 128)
+    return ascii_classes_[c];
+
+  auto it = other_classes_.find(c);
+  return it != other_classes_.end() ? it->second : kClassOther;
+}
+
+EpisodePatternMatcher::Transition& EpisodePatternMatcher::GetTransition(
+    int state, int input) {
+  return transitions_[state * class_count_ + input];
+}
+
+const EpisodePatternMatcher::Transition& EpisodePatternMatcher::GetTransition(
+    int state, int input) const {
+  return transitions_[state * class_count_ + input];
+}
@@ -0,0 +1,92 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TRACK_RECOGNITION_PATTERN_H
+#define TAIGA_TRACK_RECOGNITION_PATTERN_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum EpisodePatternResult {
+  // Not an episode number
+  kEpisodePatternNone,
+  // Not an episode number, and any number found so far is to be discarded
+  kEpisodePatternInvalid,
+  // Number, followed by an optional version
+  kEpisodePatternNumber,
+  // Version of a number that is already known
+  kEpisodePatternVersion,
+  // Number that follows an episode prefix, which needs to be validated
+  kEpisodePatternPrefixedNumber,
+  // Number that follows a season number (e.g. 2x05)
+  kEpisodePatternSeasonNumber
+};
+
+class EpisodePatternMatch {
+public:
+  EpisodePatternMatch();
+
+  int result;
+  size_t number_begin;
+  size_t number_end;
+  size_t version_begin;
+};
+
+// Episode number formats (e.g. "01v2", "01-12", "Ep.03", "S01E05") compiled
+// into a single automaton, along with the episode prefixes, so that a token
+// can be checked against all of them in one pass.
+class EpisodePatternMatcher {
+public:
+  EpisodePatternMatcher();
+  ~EpisodePatternMatcher() {}
+
+  void Compile(const std::vector<std::wstring>& prefixes);
+
+  // Separators are only meaningful after the first digit. has_number changes
+  // how the formats that can extend an existing number are handled.
+  void Match(const std::wstring& str, wchar_t separator, bool has_number,
+             EpisodePatternMatch& match) const;
+
+private:
+  class Transition {
+  public:
+    unsigned short next;
+    unsigned short action;
+  };
+
+  int AddClass(wchar_t c);
+  int AddState();
+  int GetClass(wchar_t c) const;
+  Transition& GetTransition(int state, int input);
+  const Transition& GetTransition(int state, int input) const;
+
+  // Character classes, from the characters that appear in patterns
+  unsigned char ascii_classes_[128];
+  std::unordered_map<wchar_t, int> other_classes_;
+  int class_count_;
+
+  // Indexed as [state * class_count_ + class]
+  std::vector<Transition> transitions_;
+  // Actions that are taken at the end of input, indexed by state
+  std::vector<unsigned short> final_actions_;
+  std::vector<bool> separator_states_;
+  int state_count_;
+};
+
+#endif  // TAIGA_TRACK_RECOGNITION_PATTERN_H
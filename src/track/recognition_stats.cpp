@@ -0,0 +1,111 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <windows.h>
+
+#include "base/string.h"
+#include "base/xml.h"
+#include "track/recognition_stats.h"
+
+static const wchar_t* recognition_stage_names[] = {
+  L"tokenize",
+  L"keyword",
+  L"number",
+  L"clean",
+  L"match",
+  L"score"
+};
+
+RecognitionStats::RecognitionStats() {
+  Reset();
+}
+
+void RecognitionStats::Add(volatile __int64& counter, __int64 value) {
+  InterlockedExchangeAdd64(&counter, value);
+}
+
+const wchar_t* RecognitionStats::GetStageName(int stage) {
+  return recognition_stage_names[stage];
+}
+
+// Returns the total time spent in a stage, in milliseconds
+double RecognitionStats::GetTime(int stage) const {
+  LARGE_INTEGER frequency;
+  ::QueryPerformanceFrequency(&frequency);
+
+  return static_cast<double>(times[stage]) * 1000.0 /
+         static_cast<double>(frequency.QuadPart);
+}
+
+void RecognitionStats::Reset() {
+  titles = 0;
+  tokens = 0;
+  keyword_hits = 0;
+  alias_matches = 0;
+  exact_matches = 0;
+  partial_matches = 0;
+  scored_matches = 0;
+  failed_matches = 0;
+  candidates_scored = 0;
+  candidates_skipped = 0;
+  for (int i = 0; i < kStageCount; i++)
+    times[i] = 0;
+}
+
+bool RecognitionStats::Save(const std::wstring& path) const {
+  xml_document document;
+  xml_node stats_node = document.append_child(L"recognition_stats");
+
+  #define XML_WI(n, v) \
+    XmlWriteStrValue(stats_node, n, ToWstr(static_cast<INT64>(v)).c_str())
+  XML_WI(L"titles", titles);
+  XML_WI(L"tokens", tokens);
+  XML_WI(L"keyword_hits", keyword_hits);
+  XML_WI(L"alias_matches", alias_matches);
+  XML_WI(L"exact_matches", exact_matches);
+  XML_WI(L"partial_matches", partial_matches);
+  XML_WI(L"scored_matches", scored_matches);
+  XML_WI(L"failed_matches", failed_matches);
+  XML_WI(L"candidates_scored", candidates_scored);
+  XML_WI(L"candidates_skipped", candidates_skipped);
+  #undef XML_WI
+
+  xml_node stages_node = stats_node.append_child(L"stages");
+  for (int i = 0; i < kStageCount; i++) {
+    xml_node stage_node = stages_node.append_child(L"stage");
+    stage_node.append_attribute(L"name") = GetStageName(i);
+    stage_node.append_attribute(L"time") = GetTime(i);
+  }
+
+  return XmlWriteDocumentToFile(document, path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RecognitionStopwatch::RecognitionStopwatch() {
+  LARGE_INTEGER li;
+  ::QueryPerformanceCounter(&li);
+  value_ = li.QuadPart;
+}
+
+void RecognitionStopwatch::Lap(RecognitionStats& stats, int stage) {
+  LARGE_INTEGER li;
+  ::QueryPerformanceCounter(&li);
+  RecognitionStats::Add(stats.times[stage], li.QuadPart - value_);
+  value_ = li.QuadPart;
+}
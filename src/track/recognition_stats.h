@@ -0,0 +1,73 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TRACK_RECOGNITION_STATS_H
+#define TAIGA_TRACK_RECOGNITION_STATS_H
+
+#include <string>
+
+enum RecognitionStage {
+  kStageTokenize,
+  kStageKeyword,
+  kStageNumber,
+  kStageClean,
+  kStageMatch,
+  kStageScore,  // Included in kStageMatch
+  kStageCount
+};
+
+// Counters are updated atomically, as recognition can run on several threads
+// at once. Times are kept in performance counter ticks.
+class RecognitionStats {
+public:
+  RecognitionStats();
+  ~RecognitionStats() {}
+
+  static void Add(volatile __int64& counter, __int64 value = 1);
+  static const wchar_t* GetStageName(int stage);
+
+  double GetTime(int stage) const;
+  void Reset();
+  bool Save(const std::wstring& path) const;
+
+  volatile __int64 titles;
+  volatile __int64 tokens;
+  volatile __int64 keyword_hits;
+  volatile __int64 alias_matches;  // Included in exact or partial matches
+  volatile __int64 exact_matches;
+  volatile __int64 partial_matches;
+  volatile __int64 scored_matches;
+  volatile __int64 failed_matches;
+  volatile __int64 candidates_scored;
+  volatile __int64 candidates_skipped;
+  volatile __int64 times[kStageCount];
+};
+
+// Adds the time since the previous lap to a stage
+class RecognitionStopwatch {
+public:
+  RecognitionStopwatch();
+  ~RecognitionStopwatch() {}
+
+  void Lap(RecognitionStats& stats, int stage);
+
+private:
+  __int64 value_;
+};
+
+#endif  // TAIGA_TRACK_RECOGNITION_STATS_H
@@ -0,0 +1,224 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "base/foreach.h"
+#include "library/anime.h"
+#include "track/recognition_titles.h"
+
+CleanTitleStore::CleanTitleStore()
+    : unused_chars_(0),
+      unused_spans_(0),
+      title_count_(0) {
+}
+
+void CleanTitleStore::Clear() {
+  chars_.clear();
+  spans_.clear();
+  slots_.clear();
+  free_slots_.clear();
+  slot_index_.clear();
+
+  unused_chars_ = 0;
+  unused_spans_ = 0;
+  title_count_ = 0;
+}
+
+void CleanTitleStore::Reserve(size_t item_count, size_t char_count) {
+  chars_.reserve(char_count);
+  spans_.reserve(item_count * 4);
+  slots_.reserve(item_count);
+  slot_index_.rehash(item_count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool CleanTitleStore::Erase(int anime_id) {
+  auto it = slot_index_.find(anime_id);
+  if (it == slot_index_.end())
+    return false;
+
+  Slot& slot = slots_.at(it->second);
+  title_count_ -= slot.span_count;
+  Release(slot);
+  slot.anime_id = anime::ID_UNKNOWN;
+
+  free_slots_.push_back(it->second);
+  slot_index_.erase(it);
+
+  if (unused_chars_ > chars_.size() / 2)
+    Compact();
+
+  return true;
+}
+
+CleanTitleRange CleanTitleStore::Find(int anime_id) const {
+  auto it = slot_index_.find(anime_id);
+  if (it == slot_index_.end())
+    return CleanTitleRange();
+
+  const Slot& slot = slots_.at(it->second);
+  return CleanTitleRange(chars_.data(), spans_.data() + slot.span_offset,
+                         slot.span_count);
+}
+
+void CleanTitleStore::Set(int anime_id, const std::vector<std::wstring>& titles) {
+  size_t char_count = 0;
+  foreach_(it, titles)
+    char_count += it->length();
+  size_t span_count = titles.size();
+
+  size_t index = 0;
+  auto it = slot_index_.find(anime_id);
+  if (it != slot_index_.end()) {
+    index = it->second;
+  } else {
+    if (!free_slots_.empty()) {
+      index = free_slots_.back();
+      free_slots_.pop_back();
+    } else {
+      index = slots_.size();
+      slots_.resize(index + 1);
+    }
+    Slot& slot = slots_.at(index);
+    slot.anime_id = anime_id;
+    slot.char_offset = 0;
+    slot.char_capacity = 0;
+    slot.span_offset = 0;
+    slot.span_capacity = 0;
+    slot.span_count = 0;
+    slot_index_[anime_id] = index;
+  }
+
+  Slot& slot = slots_.at(index);
+  title_count_ -= slot.span_count;
+
+  // Titles are replaced in place, unless they've grown out of their space
+  if (char_count > slot.char_capacity || span_count > slot.span_capacity) {
+    Release(slot);
+    Allocate(slot, char_count, span_count);
+  }
+
+  size_t offset = slot.char_offset;
+  for (size_t i = 0; i < span_count; i++) {
+    const std::wstring& title = titles.at(i);
+    std::copy(title.begin(), title.end(), chars_.begin() + offset);
+    spans_.at(slot.span_offset + i) = std::make_pair(offset, title.length());
+    offset += title.length();
+  }
+  slot.span_count = span_count;
+  title_count_ += span_count;
+
+  if (unused_chars_ > chars_.size() / 2)
+    Compact();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CleanTitleStore::GetIds(std::vector<int>& ids) const {
+  ids.clear();
+  ids.reserve(slot_index_.size());
+
+  foreach_(it, slot_index_)
+    ids.push_back(it->first);
+
+  std::sort(ids.begin(), ids.end());
+}
+
+void CleanTitleStore::GetTitles(int anime_id,
+                                std::vector<std::wstring>& titles) const {
+  titles.clear();
+
+  CleanTitleRange range = Find(anime_id);
+  for (size_t i = 0; i < range.size(); i++)
+    titles.push_back(range[i].str());
+}
+
+// The size of the hash table is an estimate, as its layout is up to the
+// implementation
+size_t CleanTitleStore::GetMemoryUsage() const {
+  return chars_.capacity() * sizeof(wchar_t) +
+         spans_.capacity() * sizeof(std::pair<size_t, size_t>) +
+         slots_.capacity() * sizeof(Slot) +
+         free_slots_.capacity() * sizeof(size_t) +
+         slot_index_.bucket_count() * sizeof(void*) +
+         slot_index_.size() * (sizeof(std::pair<int, size_t>) +
+                               sizeof(void*) * 2);
+}
+
+size_t CleanTitleStore::item_count() const {
+  return slot_index_.size();
+}
+
+size_t CleanTitleStore::title_count() const {
+  return title_count_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CleanTitleStore::Allocate(Slot& slot, size_t char_count,
+                               size_t span_count) {
+  slot.char_offset = chars_.size();
+  slot.char_capacity = char_count;
+  chars_.resize(chars_.size() + char_count);
+
+  slot.span_offset = spans_.size();
+  slot.span_capacity = span_count;
+  spans_.resize(spans_.size() + span_count);
+}
+
+// Moves the titles of every item next to each other, in slot order
+void CleanTitleStore::Compact() {
+  std::vector<wchar_t> chars;
+  std::vector<std::pair<size_t, size_t>> spans;
+  chars.reserve(chars_.size() - unused_chars_);
+  spans.reserve(spans_.size() - unused_spans_);
+
+  foreach_(slot, slots_) {
+    if (slot->anime_id == anime::ID_UNKNOWN)
+      continue;
+    size_t char_offset = chars.size();
+    size_t span_offset = spans.size();
+    for (size_t i = 0; i < slot->span_count; i++) {
+      const auto& span = spans_.at(slot->span_offset + i);
+      spans.push_back(std::make_pair(chars.size(), span.second));
+      chars.insert(chars.end(), chars_.begin() + span.first,
+                   chars_.begin() + span.first + span.second);
+    }
+    slot->char_offset = char_offset;
+    slot->char_capacity = chars.size() - char_offset;
+    slot->span_offset = span_offset;
+    slot->span_capacity = slot->span_count;
+  }
+
+  chars_.swap(chars);
+  spans_.swap(spans);
+
+  unused_chars_ = 0;
+  unused_spans_ = 0;
+}
+
+void CleanTitleStore::Release(Slot& slot) {
+  unused_chars_ += slot.char_capacity;
+  unused_spans_ += slot.span_capacity;
+
+  slot.char_capacity = 0;
+  slot.span_capacity = 0;
+  slot.span_count = 0;
+}
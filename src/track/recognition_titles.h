@@ -0,0 +1,118 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TRACK_RECOGNITION_TITLES_H
+#define TAIGA_TRACK_RECOGNITION_TITLES_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Points into a CleanTitleStore, and is only valid until the store is modified
+class CleanTitleView {
+public:
+  CleanTitleView() : data(nullptr), length(0) {}
+  CleanTitleView(const wchar_t* data, size_t length)
+      : data(data), length(length) {}
+
+  bool empty() const { return length == 0; }
+  std::wstring str() const { return std::wstring(data, length); }
+
+  const wchar_t* data;
+  size_t length;
+};
+
+// Clean titles of a single item
+class CleanTitleRange {
+public:
+  CleanTitleRange() : chars_(nullptr), spans_(nullptr), count_(0) {}
+  CleanTitleRange(const wchar_t* chars, const std::pair<size_t, size_t>* spans,
+                  size_t count)
+      : chars_(chars), spans_(spans), count_(count) {}
+
+  CleanTitleView operator[](size_t index) const {
+    return CleanTitleView(chars_ + spans_[index].first, spans_[index].second);
+  }
+
+  bool empty() const { return count_ == 0; }
+  size_t size() const { return count_; }
+
+private:
+  const wchar_t* chars_;
+  const std::pair<size_t, size_t>* spans_;
+  size_t count_;
+};
+
+// Keeps the clean titles of every item in a single character buffer, so that
+// going through them doesn't take an allocation per title. Each item is given
+// a slot, which holds the position of its titles in the buffer. Titles are
+// replaced in place if they fit, and the buffer is compacted once too much of
+// it is left unused.
+class CleanTitleStore {
+public:
+  CleanTitleStore();
+  ~CleanTitleStore() {}
+
+  void Clear();
+  void Reserve(size_t item_count, size_t char_count);
+
+  bool Erase(int anime_id);
+  CleanTitleRange Find(int anime_id) const;
+  void Set(int anime_id, const std::vector<std::wstring>& titles);
+
+  void GetIds(std::vector<int>& ids) const;
+  void GetTitles(int anime_id, std::vector<std::wstring>& titles) const;
+
+  // Returns the number of bytes that are allocated for the titles
+  size_t GetMemoryUsage() const;
+
+  size_t item_count() const;
+  size_t title_count() const;
+
+private:
+  class Slot {
+  public:
+    int anime_id;
+    size_t char_offset;
+    size_t char_capacity;
+    size_t span_offset;
+    size_t span_capacity;
+    size_t span_count;
+  };
+
+  void Allocate(Slot& slot, size_t char_count, size_t span_count);
+  void Compact();
+  void Release(Slot& slot);
+
+  // Titles of all items, without terminating null characters
+  std::vector<wchar_t> chars_;
+  // Pairs of <offset in chars_, length> for each title
+  std::vector<std::pair<size_t, size_t>> spans_;
+
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_slots_;
+  // Mapped as <anime_id, index in slots_>
+  std::unordered_map<int, size_t> slot_index_;
+
+  size_t unused_chars_;
+  size_t unused_spans_;
+  size_t title_count_;
+};
+
+#endif  // TAIGA_TRACK_RECOGNITION_TITLES_H
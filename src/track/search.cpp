@@ -24,6 +24,7 @@
 #include "library/anime_util.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
+#include "track/feed.h"
 #include "track/recognition.h"
 #include "track/search.h"
 #include "ui/ui.h"
@@ -33,6 +34,7 @@ TaigaFileSearchHelper file_search_helper;
 
 TaigaFileSearchHelper::TaigaFileSearchHelper()
     : anime_id_(anime::ID_UNKNOWN),
+      context_anime_id_(anime::ID_UNKNOWN),
       episode_number_(0) {
   // Here we assume that anything less than 10 MiB can't be a valid episode.
   minimum_file_size_ = 1024 * 1024 * 10;
@@ -40,6 +42,7 @@ TaigaFileSearchHelper::TaigaFileSearchHelper()
 
 bool TaigaFileSearchHelper::OnDirectory(const std::wstring& root,
                                         const std::wstring& name) {
+  // Names are seen once per scan, so they are not worth a place in the cache
   if (!Meow.ExamineTitle(name, episode_, false, false, false, false, false))
     return false;
 
@@ -79,59 +82,152 @@ bool TaigaFileSearchHelper::OnDirectory(const std::wstring& root,
 
 bool TaigaFileSearchHelper::OnFile(const std::wstring& root,
                                    const std::wstring& name) {
-  if (!Meow.ExamineTitle(name, episode_, true, true, true, true, true))
+  if (!Meow.ExamineTitle(name, episode_))
+    return false;
+
+  return MatchFile(root, name);
+}
+
+// Library folders may hold thousands of files, so their names are examined
+// together on all processors. Then they are matched one by one, as before.
+bool TaigaFileSearchHelper::OnFiles(const std::wstring& root,
+                                    const std::vector<std::wstring>& names) {
+  ParseOptions parse_options;
+  parse_options.match_database = false;
+  std::vector<anime::Episode> episodes;
+  std::vector<char> examined;
+  Meow.ExamineTitles(names, episodes, examined, parse_options, false);
+
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!examined.at(i))
+      continue;
+    episode_ = episodes.at(i);
+    if (MatchFile(root, names.at(i)))
+      return true;
+  }
+
+  return false;
+}
+
+// Matches the file to an item in the list, once its name is examined into
+// episode_.
+bool TaigaFileSearchHelper::MatchFile(const std::wstring& root,
+                                      const std::wstring& name) {
+  const std::wstring path = AddTrailingSlash(root) + name;
+  bool found = false;
+
+  // Files that were downloaded through a feed are known by their checksum
+  if (Aggregator.SearchChecksumIndex(episode_)) {
+    auto anime_item = AnimeDatabase.FindItem(episode_.anime_id);
+    if (anime_item && IsCandidate(*anime_item) &&
+        SetEpisodeAvailability(*anime_item, path, found))
+      return found;
+  }
+
+  if (!IsEqual(root, context_root_))
+    SetFolderContext(root);
+
+  // A single comparison is usually enough for the siblings of a matched file
+  if (context_anime_id_ != anime::ID_UNKNOWN) {
+    auto anime_item = AnimeDatabase.FindItem(context_anime_id_);
+    if (anime_item && IsCandidate(*anime_item) &&
+        Meow.CompareEpisode(episode_, *anime_item) &&
+        SetEpisodeAvailability(*anime_item, path, found))
+      return found;
+  }
+
+  // If we're looking for a particular anime, there is nothing else to compare
+  if (anime_id_ != anime::ID_UNKNOWN)
     return false;
 
   foreach_r_(it, AnimeDatabase.items) {
     anime::Item& anime_item = it->second;
 
-    if (anime_id_ != anime::ID_UNKNOWN) {
-      if (anime_item.GetId() != anime_id_)
-        continue;
-    } else {
-      switch (anime_item.GetMyStatus()) {
-        case anime::kNotInList:
-        case anime::kCompleted:
-        case anime::kDropped:
-          continue;
-      }
-    }
+    // Already compared above
+    if (anime_item.GetId() == context_anime_id_)
+      continue;
+    if (!IsCandidate(anime_item))
+      continue;
 
     if (!Meow.CompareEpisode(episode_, anime_item))
       continue;
 
-    int upper_bound = anime::GetEpisodeHigh(episode_.number);
-    int lower_bound = anime::GetEpisodeLow(episode_.number);
-
-    if (!anime::IsValidEpisode(upper_bound, anime_item.GetEpisodeCount()) ||
-        !anime::IsValidEpisode(lower_bound, anime_item.GetEpisodeCount())) {
-      LOG(LevelWarning, L"Invalid episode number: " + episode_.number);
-      LOG(LevelWarning, L"File: " + AddTrailingSlash(root) + name);
+    if (!SetEpisodeAvailability(anime_item, path, found))
       continue;
-    }
 
-    for (int i = lower_bound; i <= upper_bound; i++)
-      anime_item.SetEpisodeAvailability(
-          i, true, AddTrailingSlash(root) + name);
+    context_anime_id_ = anime_item.GetId();
+    return found;
+  }
 
-    // Check if we've found the episode we were looking for
-    if (episode_number_ > 0 &&
-        episode_number_ >= lower_bound &&
-        episode_number_ <= upper_bound) {
-      path_found_ = AddTrailingSlash(root) + name;
-      return true;
-    }
-    // Check if all episodes are available
-    if (episode_number_ == 0 &&
-        anime_id_ != anime::ID_UNKNOWN &&
-        IsAllEpisodesAvailable(anime_item)) {
-      return true;
-    }
+  return false;
+}
+
+bool TaigaFileSearchHelper::IsCandidate(const anime::Item& anime_item) const {
+  if (anime_id_ != anime::ID_UNKNOWN)
+    return anime_item.GetId() == anime_id_;
+
+  switch (anime_item.GetMyStatus()) {
+    case anime::kNotInList:
+    case anime::kCompleted:
+    case anime::kDropped:
+      return false;
+  }
+
+  return true;
+}
 
+// Returns false if the episode number is not valid for the item. Otherwise,
+// found is set if the search can be stopped.
+bool TaigaFileSearchHelper::SetEpisodeAvailability(anime::Item& anime_item,
+                                                   const std::wstring& path,
+                                                   bool& found) {
+  int upper_bound = anime::GetEpisodeHigh(episode_.number);
+  int lower_bound = anime::GetEpisodeLow(episode_.number);
+
+  if (!anime::IsValidEpisode(upper_bound, anime_item.GetEpisodeCount()) ||
+      !anime::IsValidEpisode(lower_bound, anime_item.GetEpisodeCount())) {
+    LOG(LevelWarning, L"Invalid episode number: " + episode_.number);
+    LOG(LevelWarning, L"File: " + path);
     return false;
   }
 
-  return false;
+  for (int i = lower_bound; i <= upper_bound; i++)
+    anime_item.SetEpisodeAvailability(i, true, path);
+
+  // Check if we've found the episode we were looking for
+  if (episode_number_ > 0 &&
+      episode_number_ >= lower_bound &&
+      episode_number_ <= upper_bound) {
+    path_found_ = path;
+    found = true;
+  // Check if all episodes are available
+  } else if (episode_number_ == 0 &&
+             anime_id_ != anime::ID_UNKNOWN &&
+             IsAllEpisodesAvailable(anime_item)) {
+    found = true;
+  }
+
+  return true;
+}
+
+// Starts off with the anime we're looking for, or the one that the folder
+// belongs to. Otherwise the first file that matches sets the context.
+void TaigaFileSearchHelper::SetFolderContext(const std::wstring& root) {
+  context_root_ = root;
+  context_anime_id_ = anime_id_;
+
+  if (context_anime_id_ != anime::ID_UNKNOWN)
+    return;
+
+  foreach_(it, AnimeDatabase.items) {
+    const anime::Item& anime_item = it->second;
+    if (!anime_item.GetFolder().empty() &&
+        IsEqual(anime_item.GetFolder(), root) &&
+        IsCandidate(anime_item)) {
+      context_anime_id_ = anime_item.GetId();
+      break;
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -142,6 +238,7 @@ const std::wstring& TaigaFileSearchHelper::path_found() const {
 
 void TaigaFileSearchHelper::set_anime_id(int anime_id) {
   anime_id_ = anime_id;
+  context_root_.clear();
 }
 
 void TaigaFileSearchHelper::set_episode_number(int episode_number) {
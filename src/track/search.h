@@ -20,10 +20,15 @@
 #define TAIGA_TRACK_SEARCH_H
 
 #include <string>
+#include <vector>
 
 #include "base/file.h"
 #include "library/anime_episode.h"
 
+namespace anime {
+class Item;
+}
+
 class TaigaFileSearchHelper : public FileSearchHelper {
 public:
   TaigaFileSearchHelper();
@@ -31,6 +36,8 @@ public:
 
   bool OnDirectory(const std::wstring& root, const std::wstring& name);
   bool OnFile(const std::wstring& root, const std::wstring& name);
+  bool OnFiles(const std::wstring& root,
+               const std::vector<std::wstring>& names);
 
   const std::wstring& path_found() const;
 
@@ -39,7 +46,17 @@ public:
   void set_path_found(const std::wstring& path_found);
 
 private:
+  bool IsCandidate(const anime::Item& anime_item) const;
+  bool MatchFile(const std::wstring& root, const std::wstring& name);
+  bool SetEpisodeAvailability(anime::Item& anime_item, const std::wstring& path,
+                              bool& found);
+  void SetFolderContext(const std::wstring& root);
+
   int anime_id_;
+  // Files in the same folder usually belong to the same anime, so the item
+  // that matched the folder or its previous file is compared first
+  int context_anime_id_;
+  std::wstring context_root_;
   anime::Episode episode_;
   int episode_number_;
   std::wstring path_found_;